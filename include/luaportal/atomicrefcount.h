@@ -0,0 +1,33 @@
+#pragma once
+#include<atomic>
+
+//==============================================================================
+/**
+ Operations on an atomic reference count, shared by AtomicRefCountedObject
+ and RefCountedPtr's AtomicIntrusiveRefCount.
+
+ A new reference is always made from an existing one, so the increment is
+ relaxed. The decrement is acquire-release: the thread deleting the object
+ sees all writes made through the other references.
+ */
+struct AtomicRefCount
+{
+    template<typename T>
+    static void Increment(std::atomic<T>& count)
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    /** Returns true when the last reference went away. */
+    template<typename T>
+    static bool Decrement(std::atomic<T>& count)
+    {
+        return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+    
+    template<typename T>
+    static T Get(std::atomic<T> const& count)
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,481 @@
+//==============================================================================
+/**
+ Base class of the memory allocators a LuaState can be created with.
+
+ The allocator receives every block request of its state through the
+ lua_Alloc returned by GetFunction(), installed with the allocator itself as
+ userdata. Lua always passes the size of the block being reallocated or freed,
+ so implementations can index their bookkeeping by size instead of storing a
+ header in front of each block.
+
+ An allocator serves a single lua_State and is not thread safe. It must
+ outlive the state; LuaState takes care of that by owning it.
+ */
+class LuaAllocator
+{
+public:
+    virtual ~LuaAllocator()
+    {
+    }
+
+    /** Return a block of at least size bytes, or NULL. */
+    virtual void* Allocate(size_t size) = 0;
+
+    /** Release a block of the given size previously returned by this allocator. */
+    virtual void Free(void* p, size_t size) = 0;
+
+    /** Resize a block, preserving its contents up to the smaller size. */
+    virtual void* Reallocate(void* p, size_t oldSize, size_t newSize)
+    {
+        void* q = Allocate(newSize);
+        if(q != NULL)
+        {
+            memcpy(q, p, oldSize< newSize ? oldSize : newSize);
+            Free(p, oldSize);
+        }
+        return q;
+    }
+
+    /** The lua_Alloc to pass to lua_newstate together with this allocator. */
+    virtual lua_Alloc GetFunction() const
+    {
+        return &LuaAlloc<LuaAllocator>;
+    }
+
+protected:
+    /** Forward a lua_Alloc request to A, which lets final classes skip the
+        virtual dispatch.
+     */
+    template<typename A>
+    static void* LuaAlloc(void* ud, void* ptr, size_t osize, size_t nsize)
+    {
+        A* allocator = static_cast<A*>(static_cast<LuaAllocator*>(ud));
+        if(nsize == 0)
+        {
+            if(ptr != NULL)
+                allocator->Free(ptr, osize);
+            return NULL;
+        }
+        if(ptr == NULL)
+            return allocator->Allocate(nsize);
+        return allocator->Reallocate(ptr, osize, nsize);
+    }
+};
+
+//==============================================================================
+/**
+ A size-class pool allocator.
+
+ Blocks up to MaxPooledSize bytes are rounded up to a multiple of Granularity
+ and served from per-class free lists carved out of large chunks, which covers
+ Lua's strings, small tables and their parts, closures, upvalues and the
+ UserdataValue/UserdataPtr blocks of bound objects. Larger blocks go to
+ malloc. Freed blocks return to their free list and chunks are only released
+ when the allocator is destroyed.
+ */
+class PoolAllocator final : public LuaAllocator
+{
+public:
+    enum
+    {
+        Granularity = 16,
+        MaxPooledSize = 256,
+        NumClasses = MaxPooledSize / Granularity,
+        DefaultChunkSize = 64 * 1024
+    };
+
+    explicit PoolAllocator(size_t chunkSize = DefaultChunkSize)
+    : m_chunkSize(chunkSize< MaxPooledSize ? static_cast<size_t>(MaxPooledSize) : chunkSize)
+    {
+        for(int i = 0; i< NumClasses; ++i)
+        {
+            m_free [i] = NULL;
+        }
+    }
+
+    ~PoolAllocator()
+    {
+        for(size_t i = 0; i< m_chunks.size(); ++i)
+        {
+            free(m_chunks [i]);
+        }
+    }
+
+    void* Allocate(size_t size) override
+    {
+        if(size > MaxPooledSize)
+            return malloc(size);
+
+        int const c = ClassOf(size);
+        FreeBlock* block = m_free [c];
+        if(block == NULL)
+        {
+            block = Refill(c);
+            if(block == NULL)
+                return NULL;
+        }
+        m_free [c] = block->next;
+        return block;
+    }
+
+    void Free(void* p, size_t size) override
+    {
+        if(size > MaxPooledSize)
+        {
+            free(p);
+            return;
+        }
+
+        int const c = ClassOf(size);
+        FreeBlock* block = static_cast<FreeBlock*>(p);
+        block->next = m_free [c];
+        m_free [c] = block;
+    }
+
+    void* Reallocate(void* p, size_t oldSize, size_t newSize) override
+    {
+        if(oldSize > MaxPooledSize && newSize > MaxPooledSize)
+            return realloc(p, newSize);
+
+        // Shrinking or growing within the same size class keeps the block.
+        if(oldSize<= MaxPooledSize && newSize<= MaxPooledSize && ClassOf(oldSize) == ClassOf(newSize))
+            return p;
+
+        void* const q = LuaAllocator::Reallocate(p, oldSize, newSize);
+        if(q == NULL && newSize< oldSize)
+        {
+            // Lua 5.1 to 5.3 assume that a shrink never fails. Keep the block,
+            // it is large enough for the new size class it belongs to from now
+            // on. A malloc block is adopted as a chunk so that it is still
+            // released with the allocator.
+            if(oldSize > MaxPooledSize)
+                Adopt(p);
+            return p;
+        }
+        return q;
+    }
+
+    lua_Alloc GetFunction() const override
+    {
+        return &LuaAlloc<PoolAllocator>;
+    }
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    static int ClassOf(size_t size)
+    {
+        return static_cast<int>((size + Granularity - 1) / Granularity) - 1;
+    }
+
+    /** Carve a new chunk into blocks of class c and return the first one. */
+    FreeBlock* Refill(int c)
+    {
+        size_t const blockSize = static_cast<size_t>(c + 1) * Granularity;
+        size_t const count = m_chunkSize / blockSize;
+        char* chunk = static_cast<char*>(malloc(count * blockSize));
+        if(chunk == NULL)
+            return NULL;
+        m_chunks.push_back(chunk);
+
+        FreeBlock* head = NULL;
+        for(size_t i = count; i > 0; --i)
+        {
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + (i - 1) * blockSize);
+            block->next = head;
+            head = block;
+        }
+        m_free [c] = head;
+        return head;
+    }
+
+    /** Take ownership of a malloc block that now serves a size class. */
+    void Adopt(void* p)
+    {
+        try
+        {
+            m_chunks.push_back(static_cast<char*>(p));
+        }
+        catch(std::bad_alloc const&)
+        {
+            // Out of memory, the block stays in use but is never released.
+        }
+    }
+
+    size_t const m_chunkSize;
+    FreeBlock* m_free [NumClasses];
+    std::vector<char*> m_chunks;
+
+    PoolAllocator(PoolAllocator const&);
+    PoolAllocator& operator=(PoolAllocator const&);
+};
+
+//==============================================================================
+/**
+ A bump arena for short-lived states that are destroyed wholesale.
+
+ Allocation advances a pointer through large blocks; freeing only reclaims the
+ most recent allocation, everything else is returned when the allocator is
+ destroyed. Memory use therefore grows with the total amount a state ever
+ allocates, which suits states that run a bounded job and are thrown away,
+ not long-running ones.
+ */
+class ArenaAllocator final : public LuaAllocator
+{
+public:
+    enum
+    {
+        Alignment = 16,
+        DefaultBlockSize = 256 * 1024
+    };
+
+    explicit ArenaAllocator(size_t blockSize = DefaultBlockSize)
+    : m_blockSize(blockSize)
+    , m_reserved(0)
+    , m_cursor(NULL)
+    , m_end(NULL)
+    , m_last(NULL)
+    {
+    }
+
+    ~ArenaAllocator()
+    {
+        for(size_t i = 0; i< m_blocks.size(); ++i)
+        {
+            free(m_blocks [i]);
+        }
+    }
+
+    void* Allocate(size_t size) override
+    {
+        size = AlignUp(size);
+        if(static_cast<size_t>(m_end - m_cursor)< size && !Grow(size))
+            return NULL;
+
+        m_last = m_cursor;
+        m_cursor += size;
+        return m_last;
+    }
+
+    void Free(void* p, size_t) override
+    {
+        if(p == m_last)
+        {
+            m_cursor = m_last;
+            m_last = NULL;
+        }
+    }
+
+    void* Reallocate(void* p, size_t oldSize, size_t newSize) override
+    {
+        if(AlignUp(newSize)<= AlignUp(oldSize))
+        {
+            if(p == m_last)
+                m_cursor = m_last + AlignUp(newSize);
+            return p;
+        }
+
+        // The most recent allocation can grow in place.
+        if(p == m_last && static_cast<size_t>(m_end - m_last) >= AlignUp(newSize))
+        {
+            m_cursor = m_last + AlignUp(newSize);
+            return p;
+        }
+
+        return LuaAllocator::Reallocate(p, oldSize, newSize);
+    }
+
+    lua_Alloc GetFunction() const override
+    {
+        return &LuaAlloc<ArenaAllocator>;
+    }
+
+    /** Total bytes reserved from the system. */
+    size_t GetReservedBytes() const
+    {
+        return m_reserved;
+    }
+
+private:
+    static size_t AlignUp(size_t size)
+    {
+        return (size + Alignment - 1) & ~static_cast<size_t>(Alignment - 1);
+    }
+
+    bool Grow(size_t size)
+    {
+        size_t const blockSize = size > m_blockSize ? size : m_blockSize;
+        char* block = static_cast<char*>(malloc(blockSize));
+        if(block == NULL)
+            return false;
+
+        m_blocks.push_back(block);
+        m_reserved += blockSize;
+        m_cursor = block;
+        m_end = block + blockSize;
+        m_last = NULL;
+        return true;
+    }
+
+    size_t const m_blockSize;
+    size_t m_reserved;
+    char* m_cursor;
+    char* m_end;
+    char* m_last;
+    std::vector<char*> m_blocks;
+
+    ArenaAllocator(ArenaAllocator const&);
+    ArenaAllocator& operator=(ArenaAllocator const&);
+};
+
+//==============================================================================
+/**
+ Memory usage of a LuaState, as recorded by MemoryTracker.
+ */
+struct LuaMemoryStats
+{
+    enum
+    {
+        /** Histogram buckets: up to 16 bytes, 32, 64, ... 4096, and larger. */
+        NumBuckets = 10
+    };
+
+    LuaMemoryStats()
+    : liveBytes(0)
+    , peakBytes(0)
+    , allocations(0)
+    , reallocations(0)
+    , frees(0)
+    , failedAllocations(0)
+    , limit(0)
+    {
+        for(int i = 0; i< NumBuckets; ++i)
+        {
+            histogram [i] = 0;
+        }
+    }
+
+    /** The histogram bucket of a block of the given size. */
+    static int BucketOf(size_t size)
+    {
+        int bucket = 0;
+        for(size_t upper = 16; bucket< NumBuckets - 1 && size > upper; upper <<= 1)
+        {
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    /** Bytes currently allocated by the state. */
+    size_t liveBytes;
+    /** Highest liveBytes seen since tracking was enabled. */
+    size_t peakBytes;
+    /** New blocks allocated. */
+    size_t allocations;
+    /** Blocks resized. */
+    size_t reallocations;
+    /** Blocks released. */
+    size_t frees;
+    /** Requests refused because of the limit or by the underlying allocator. */
+    size_t failedAllocations;
+    /** The byte limit, 0 if unlimited. */
+    size_t limit;
+    /** Allocations and reallocations by requested block size. */
+    size_t histogram [NumBuckets];
+};
+
+//==============================================================================
+/**
+ Records the memory use of a lua_State and optionally caps it.
+
+ The tracker installs itself in front of the allocator the state already
+ uses. Live bytes are seeded from the collector's count, so it can be
+ enabled at any point; the other counters cover the time since then. When a
+ limit is set, requests that would grow the state beyond it fail, which
+ makes Lua raise a memory error(after an emergency collection on 5.2 and
+ later) instead of letting the process run out of memory. Shrinking and
+ freeing never fail, as Lua requires.
+ */
+class MemoryTracker
+{
+public:
+    explicit MemoryTracker(lua_State* L)
+    : L(L)
+    {
+        m_next = lua_getallocf(L, &m_nextUd);
+        m_stats.liveBytes = static_cast<size_t>(lua_gc(L, LUA_GCCOUNT, 0)) * 1024
+                          + static_cast<size_t>(lua_gc(L, LUA_GCCOUNTB, 0));
+        m_stats.peakBytes = m_stats.liveBytes;
+        lua_setallocf(L, &Alloc, this);
+    }
+
+    /** Restore the previous allocator; the state must still be open. */
+    ~MemoryTracker()
+    {
+        lua_setallocf(L, m_next, m_nextUd);
+    }
+
+    LuaMemoryStats const& GetStats() const
+    {
+        return m_stats;
+    }
+
+    /** Cap the live bytes of the state, 0 removes the limit. */
+    void SetLimit(size_t limit)
+    {
+        m_stats.limit = limit;
+    }
+
+private:
+    static void* Alloc(void* ud, void* ptr, size_t osize, size_t nsize)
+    {
+        MemoryTracker* tracker = static_cast<MemoryTracker*>(ud);
+        LuaMemoryStats& stats = tracker->m_stats;
+        size_t const oldSize = ptr != NULL ? osize : 0;
+
+        if(nsize == 0)
+        {
+            tracker->m_next(tracker->m_nextUd, ptr, osize, 0);
+            if(ptr != NULL)
+            {
+                stats.liveBytes -= oldSize;
+                ++stats.frees;
+            }
+            return NULL;
+        }
+
+        if(stats.limit != 0 && nsize > oldSize && stats.liveBytes - oldSize + nsize > stats.limit)
+        {
+            ++stats.failedAllocations;
+            return NULL;
+        }
+
+        void* p = tracker->m_next(tracker->m_nextUd, ptr, osize, nsize);
+        if(p == NULL)
+        {
+            ++stats.failedAllocations;
+            return NULL;
+        }
+
+        stats.liveBytes = stats.liveBytes - oldSize + nsize;
+        if(stats.liveBytes > stats.peakBytes)
+            stats.peakBytes = stats.liveBytes;
+        if(ptr == NULL)
+            ++stats.allocations;
+        else
+            ++stats.reallocations;
+        ++stats.histogram [LuaMemoryStats::BucketOf(nsize)];
+        return p;
+    }
+
+    lua_State* L;
+    lua_Alloc m_next;
+    void* m_nextUd;
+    LuaMemoryStats m_stats;
+
+    MemoryTracker(MemoryTracker const&);
+    MemoryTracker& operator=(MemoryTracker const&);
+};
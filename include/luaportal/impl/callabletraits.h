@@ -80,88 +80,131 @@ template<typename Callable>
 struct callable_traits : luaportal::callable_traits_d<typename std::remove_reference<Callable>::type> {
 };
 
-template<typename LambdaType, typename... Params>
-struct RecursiveLambda{};
-
-template<typename LambdaType>
-struct RecursiveLambda<LambdaType>{
-    template<typename... U>
-    static void callVoidLambda(LambdaType func, lua_State *L, int start, U... u) {
-        func(u...);
+//------------------------------------------------------------------------------
+/**
+ Storage of a callable in a full userdata, used as upvalue of the lambda
+ bindings.
+ 
+ The callable is kept as its concrete closure type, so no std::function
+ type erasure is involved and calls go directly to its operator(). A __gc
+ metamethod is attached only when the closure is not trivially destructible.
+ */
+template<typename Callable>
+struct CallableUserdata
+{
+    static void Push(lua_State* L, Callable const& callable)
+    {
+        new(luaS_newuserdata(L, sizeof(Callable), 0)) Callable(callable);
+        if(!std::is_trivially_destructible<Callable>::value)
+        {
+            lua_rawgetp(L, LUA_REGISTRYINDEX, GetMetatableKey());
+            if(lua_isnil(L, -1))
+            {
+                lua_pop(L, 1);
+                lua_newtable(L);
+                lua_pushcfunction(L, &GCMetaMethod);
+                rawsetfield(L, -2, "__gc");
+                lua_pushvalue(L, -1);
+                lua_rawsetp(L, LUA_REGISTRYINDEX, GetMetatableKey());
+            }
+            lua_setmetatable(L, -2);
+        }
     }
     
-    template<typename ReturnType, typename... U>
-    static ReturnType callLambda(LambdaType func, lua_State *L, int start, U... u) {
-        return func(u...);
+    /** Get the callable stored in the given upvalue.
+     */
+    static inline Callable& Get(lua_State* L, int upvalue = 1)
+    {
+        return *static_cast<Callable*>(lua_touserdata(L, lua_upvalueindex(upvalue)));
+    }
+    
+private:
+    static int GCMetaMethod(lua_State* L)
+    {
+        static_cast<Callable*>(lua_touserdata(L, 1))->~Callable();
+        return 0;
+    }
+    
+    static void const* GetMetatableKey()
+    {
+        static char value;
+        return &value;
     }
 };
 
-template<typename LambdaType, typename H,typename... Params>
-struct RecursiveLambda<LambdaType, H, Params...>{
-    template<typename... U>
-    static void callVoidLambda(LambdaType func, lua_State *L,int start, U... u) {
-        H h = Stack<H>::Get(L, sizeof...(u) + start);
-        RecursiveLambda<LambdaType, Params...>::callVoidLambda(func, L, start, u..., h);
+/**
+ Call a callable with the arguments at stack index start and up, after the
+ given leading arguments.
+ */
+template<typename LambdaType, typename... Params>
+struct ApplyLambda
+{
+    template<typename ReturnType, typename... U>
+    static ReturnType Call(LambdaType& func, lua_State *L, int start, U... u)
+    {
+        return Call<ReturnType>(typename MakeIndexSequence<sizeof...(Params)>::Type(), func, L, start, u...);
     }
     
-    template<typename ReturnType, typename... U>
-    static ReturnType callLambda(LambdaType func, lua_State *L,int start, U... u) {
-        H h = Stack<H>::Get(L, sizeof...(u) + start);
-        return RecursiveLambda<LambdaType, Params...>::template callLambda<ReturnType>(func, L, start, u..., h);
+private:
+    template<typename ReturnType, size_t... I, typename... U>
+    static ReturnType Call(IndexSequence<I...>, LambdaType& func, lua_State *L, int start, U... u)
+    {
+        (void)L;
+        (void)start;
+        typename StackArgs<Params...>::Type args{Stack<Params>::Get(L, start + static_cast<int>(I))...};
+        return func(u..., std::get<I>(std::move(args))...);
     }
 };
 
-template<typename T, typename MemLambda>
+template<typename T, typename Callable,
+         typename FunctionType = typename callable_traits<Callable>::function_type>
 struct MemberLambda;
 
-template<typename T, typename ReturnType, typename... Params>
-struct MemberLambda<T, std::function<ReturnType(T*, Params...)> > {
+template<typename T, typename Callable, typename ReturnType, typename... Params>
+struct MemberLambda<T, Callable, ReturnType(T*, Params...)> {
     static int Call(lua_State *L)
     {
         T* t = Stack<T*>::Get(L, 1);
-        typedef std::function<ReturnType(T*, Params...)> FunctionType;
-        FunctionType func = *static_cast<FunctionType*>(lua_touserdata(L, lua_upvalueindex(1)));
-        ReturnType ret = RecursiveLambda<FunctionType, Params...>::template callLambda<ReturnType>(func, L, 1, t);
+        Callable& func = CallableUserdata<Callable>::Get(L);
+        ReturnType ret = ApplyLambda<Callable, Params...>::template Call<ReturnType>(func, L, 2, t);
         Stack<ReturnType>::Push(L, ret);
         return 1;
     }
 };
 
-template<typename T, typename... Params>
-struct MemberLambda<T, std::function<void(T*, Params...)> > {
+template<typename T, typename Callable, typename... Params>
+struct MemberLambda<T, Callable, void(T*, Params...)> {
     static int Call(lua_State *L)
     {
         T* t = Stack<T*>::Get(L, 1);
-        typedef std::function<void(T*, Params...)> FunctionType;
-        FunctionType func = *static_cast<FunctionType*>(lua_touserdata(L, lua_upvalueindex(1)));
-        RecursiveLambda<FunctionType, Params...>::callVoidLambda(func, L, 1, t);
+        Callable& func = CallableUserdata<Callable>::Get(L);
+        ApplyLambda<Callable, Params...>::template Call<void>(func, L, 2, t);
         return 0;
     }
 };
 
 
-template<typename ALambda>
+template<typename Callable,
+         typename FunctionType = typename callable_traits<Callable>::function_type>
 struct StaticLambda;
 
-template<typename ReturnType, typename... Params>
-struct StaticLambda<std::function<ReturnType(Params...)> > {
+template<typename Callable, typename ReturnType, typename... Params>
+struct StaticLambda<Callable, ReturnType(Params...)> {
     static int Call(lua_State *L)
     {
-        typedef std::function<ReturnType(Params...)> FunctionType;
-        FunctionType func = *static_cast<FunctionType*>(lua_touserdata(L, lua_upvalueindex(1)));
-        ReturnType ret = RecursiveLambda<FunctionType, Params...>::template callLambda<ReturnType>(func, L, 1);
+        Callable& func = CallableUserdata<Callable>::Get(L);
+        ReturnType ret = ApplyLambda<Callable, Params...>::template Call<ReturnType>(func, L, 1);
         Stack<ReturnType>::Push(L, ret);
         return 1;
     }
 };
 
-template<typename... Params>
-struct StaticLambda<std::function<void(Params...)> > {
+template<typename Callable, typename... Params>
+struct StaticLambda<Callable, void(Params...)> {
     static int Call(lua_State *L)
     {
-        typedef std::function<void(Params...)> FunctionType;
-        FunctionType func = *static_cast<FunctionType*>(lua_touserdata(L, lua_upvalueindex(1)));
-        RecursiveLambda<FunctionType, Params...>::callVoidLambda(func, L, 1);
+        Callable& func = CallableUserdata<Callable>::Get(L);
+        ApplyLambda<Callable, Params...>::template Call<void>(func, L, 1);
         return 0;
     }
-};
\ No newline at end of file
+};
@@ -22,7 +22,7 @@ struct CFunc
             if(lua_isnil(L, -1))                // not found
             {
                 lua_pop(L, 1);                     // discard nil
-                rawgetfield(L, -1, "__propget");   // lookup __propget in metatable
+                rawgetkey(L, -1, PropGetKey);      // lookup __propget in metatable
                 lua_pushvalue(L, 2);               // push key arg2
                 lua_rawget(L, -2);                 // lookup key in __propget
                 lua_remove(L, -2);                 // discard __propget
@@ -48,7 +48,7 @@ struct CFunc
                 break;
             }
             
-            rawgetfield(L, -1, "__parent");
+            rawgetkey(L, -1, ParentKey);
             if(lua_istable(L, -1))
             {
                 // Remove metatable and repeat the search in __parent.
@@ -81,7 +81,7 @@ struct CFunc
         lua_getmetatable(L, 1);                // push metatable of arg1
         for(;;)
         {
-            rawgetfield(L, -1, "__propset");     // lookup __propset in metatable
+            rawgetkey(L, -1, PropSetKey);        // lookup __propset in metatable
             assert(lua_istable(L, -1));
             lua_pushvalue(L, 2);                 // push key arg2
             lua_rawget(L, -2);                   // lookup key in __propset
@@ -100,7 +100,7 @@ struct CFunc
                 lua_pop(L, 1);
             }
             
-            rawgetfield(L, -1, "__parent");
+            rawgetkey(L, -1, ParentKey);
             if(lua_istable(L, -1))
             {
                 // Remove metatable and repeat the search in __parent.
@@ -336,7 +336,7 @@ struct CFunc
     {
         static void AddFunction(lua_State* L, char const* name, MemFnPtr mf)
         {
-            new(lua_newuserdata(L, sizeof(MemFnPtr))) MemFnPtr(mf);
+            new(luaS_newuserdata(L, sizeof(MemFnPtr), 0)) MemFnPtr(mf);
             lua_pushcclosure(L, &CallConstMember<MemFnPtr>::GeneratedFunction, 1);
             lua_pushvalue(L, -1);
             rawsetfield(L, -5, name); // const table
@@ -349,7 +349,7 @@ struct CFunc
     {
         static void AddFunction(lua_State* L, char const* name, MemFnPtr mf)
         {
-            new(lua_newuserdata(L, sizeof(MemFnPtr))) MemFnPtr(mf);
+            new(luaS_newuserdata(L, sizeof(MemFnPtr), 0)) MemFnPtr(mf);
             lua_pushcclosure(L, &CallMember<MemFnPtr>::GeneratedFunction, 1);
             rawsetfield(L, -3, name); // class table
         }
@@ -363,7 +363,7 @@ struct CFunc
     static int GCMetaMethod(lua_State* L)
     {
         Userdata* const ud = Userdata::GetExact<C>(L, 1);
-        ud->~Userdata();
+        ud->Destroy();
         return 0;
     }
     
@@ -398,4 +398,82 @@ struct CFunc
         c->**mp = Stack<T>::Get(L, 2);
         return 0;
     }
+    
+    //--------------------------------------------------------------------------
+    /**
+     A property accessor called directly by the index metamethods of a class,
+     without the call frame of a nested lua_call.
+     
+     Accessors are full userdata stored in __propget and __propset in place of
+     closures, holding the function followed by its payload(the pointer to
+     member). The object is at index 1 and the value to set at index 3, as
+     passed to __index and __newindex.
+     */
+    struct Accessor
+    {
+        int(*function)(lua_State* L, Accessor const* accessor);
+    };
+    
+    template<typename Payload>
+    struct AccessorBlock
+    {
+        Accessor accessor;
+        Payload payload;
+    };
+    
+    template<typename Payload>
+    static void PushAccessor(lua_State* L, int(*function)(lua_State*, Accessor const*), Payload payload)
+    {
+        AccessorBlock<Payload>* const block =
+            static_cast<AccessorBlock<Payload>*>(luaS_newuserdata(L, sizeof(AccessorBlock<Payload>), 0));
+        block->accessor.function = function;
+        block->payload = payload;
+    }
+    
+    template<typename Payload>
+    static Payload const& GetPayload(Accessor const* accessor)
+    {
+        return reinterpret_cast<AccessorBlock<Payload> const*>(accessor)->payload;
+    }
+    
+    /** Call the accessor in the full userdata at index. */
+    static int CallAccessor(lua_State* L, int index)
+    {
+        Accessor const* const accessor = static_cast<Accessor const*>(lua_touserdata(L, index));
+        return accessor->function(L, accessor);
+    }
+    
+    template<typename C, typename T>
+    static int GetDataAccessor(lua_State* L, Accessor const* accessor)
+    {
+        C const* const c = Userdata::Get<C>(L, 1, true);
+        Stack<T>::Push(L, c->*GetPayload<T C::*>(accessor));
+        return 1;
+    }
+    
+    template<typename C, typename T>
+    static int SetDataAccessor(lua_State* L, Accessor const* accessor)
+    {
+        C* const c = Userdata::Get<C>(L, 1, false);
+        c->*GetPayload<T C::*>(accessor) = Stack<T>::Get(L, 3);
+        return 0;
+    }
+    
+    template<typename C, typename TG>
+    static int GetPropertyAccessor(lua_State* L, Accessor const* accessor)
+    {
+        typedef TG(C::*get_t)() const;
+        C const* const c = Userdata::Get<C>(L, 1, true);
+        Stack<TG>::Push(L, (c->*GetPayload<get_t>(accessor))());
+        return 1;
+    }
+    
+    template<typename C, typename TS>
+    static int SetPropertyAccessor(lua_State* L, Accessor const* accessor)
+    {
+        typedef void(C::*set_t)(TS);
+        C* const c = Userdata::Get<C>(L, 1, false);
+        (c->*GetPayload<set_t>(accessor))(Stack<TS>::Get(L, 3));
+        return 0;
+    }
 };
@@ -0,0 +1,346 @@
+/**/
+
+/*
+ * Hit and miss counters of a ChunkCache.
+ */
+struct ChunkCacheStats {
+    ChunkCacheStats()
+    : hits(0)
+    , misses(0)
+    , bytecodeHits(0)
+    , bytecodeMisses(0)
+    , bytecodeWrites(0)
+    , evictions(0) {
+    }
+
+    /* Chunks served from the registry without compiling. */
+    size_t hits;
+    /* Chunks that had to be loaded(from source or bytecode). */
+    size_t misses;
+    /* Misses served from the on-disk bytecode cache. */
+    size_t bytecodeHits;
+    /* Misses with no usable bytecode file, compiled from source. */
+    size_t bytecodeMisses;
+    /* Bytecode files written after compiling from source. */
+    size_t bytecodeWrites;
+    /* String chunks dropped to stay within the string limit. */
+    size_t evictions;
+};
+
+/*
+ * Keeps the compiled functions of loaded chunks in the registry so that
+ * running the same script again skips the parser.
+ *
+ * Files are keyed by path and revalidated against their modification time and
+ * size on every load; strings are keyed by their content. Scripts built at
+ * runtime would make the string entries grow without bound, so only the most
+ * recently used strings are kept(see SetMaxStrings). With a bytecode
+ * directory set, compiled files are also written there with lua_dump and
+ * loaded from it on the next cold start, again checked against the mtime and
+ * size of the source. Only point the bytecode directory at a location that is
+ * trusted: Lua performs no verification of precompiled chunks.
+ */
+class ChunkCache {
+private:
+    struct FileEntry {
+        int ref;
+        long long mtime;
+        long long size;
+    };
+
+    /* Most recently used first, pointing at the keys of m_strings. */
+    typedef std::list<const std::string*> StringOrder;
+
+    struct StringEntry {
+        int ref;
+        StringOrder::iterator order;
+    };
+
+    lua_State *L;
+    std::string m_bytecodeDir;
+    std::unordered_map<std::string, FileEntry> m_files;
+    std::unordered_map<std::string, StringEntry> m_strings;
+    StringOrder m_stringOrder;
+    size_t m_maxStrings;
+    ChunkCacheStats m_stats;
+
+public:
+
+    enum {
+        DefaultMaxStrings = 256
+    };
+
+    explicit ChunkCache(lua_State *state, const std::string &bytecodeDir = std::string())
+    : L(state)
+    , m_bytecodeDir(bytecodeDir)
+    , m_maxStrings(DefaultMaxStrings) {
+    }
+
+    ~ChunkCache() {
+        Clear();
+    }
+
+    /*
+     * Push the compiled chunk of the file at path, as luaL_loadfile does.
+     */
+    int LoadFile(const std::string &path)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+        {
+            // Let luaL_loadfile report the error.
+            ++m_stats.misses;
+            return luaL_loadfile(L, path.c_str());
+        }
+
+        const long long mtime = static_cast<long long>(st.st_mtime);
+        const long long size = static_cast<long long>(st.st_size);
+
+        auto it = m_files.find(path);
+        if (it != m_files.end() && it->second.mtime == mtime && it->second.size == size)
+        {
+            ++m_stats.hits;
+            lua_rawgeti(L, LUA_REGISTRYINDEX, it->second.ref);
+            return LUAPORTAL_LUA_OK;
+        }
+        ++m_stats.misses;
+
+        int status = LUAPORTAL_LUA_OK;
+        if (!LoadBytecode(path, mtime, size))
+        {
+            status = luaL_loadfile(L, path.c_str());
+            if (status == LUAPORTAL_LUA_OK)
+            {
+                SaveBytecode(path, mtime, size);
+            }
+        }
+
+        if (status == LUAPORTAL_LUA_OK)
+        {
+            lua_pushvalue(L, -1);
+            const int ref = luaL_ref(L, LUA_REGISTRYINDEX);
+            if (it != m_files.end())
+            {
+                luaL_unref(L, LUA_REGISTRYINDEX, it->second.ref);
+                it->second.ref = ref;
+                it->second.mtime = mtime;
+                it->second.size = size;
+            }
+            else
+            {
+                FileEntry entry = { ref, mtime, size };
+                m_files.insert(std::make_pair(path, entry));
+            }
+        }
+        return status;
+    }
+
+    /*
+     * Push the compiled chunk of content, as luaL_loadstring does. Not called
+     * LoadString, which <windows.h> defines as a macro.
+     */
+    int LoadSource(const std::string &content)
+    {
+        auto it = m_strings.find(content);
+        if (it != m_strings.end())
+        {
+            ++m_stats.hits;
+            m_stringOrder.splice(m_stringOrder.begin(), m_stringOrder, it->second.order);
+            lua_rawgeti(L, LUA_REGISTRYINDEX, it->second.ref);
+            return LUAPORTAL_LUA_OK;
+        }
+        ++m_stats.misses;
+
+        const int status = luaL_loadstring(L, content.c_str());
+        if (status == LUAPORTAL_LUA_OK && m_maxStrings > 0)
+        {
+            TrimStrings(m_maxStrings - 1);
+            lua_pushvalue(L, -1);
+            StringEntry entry = { luaL_ref(L, LUA_REGISTRYINDEX), StringOrder::iterator() };
+            it = m_strings.insert(std::make_pair(content, entry)).first;
+            m_stringOrder.push_front(&it->first);
+            it->second.order = m_stringOrder.begin();
+        }
+        return status;
+    }
+
+    /*
+     * Keep at most count string chunks, dropping the least recently used
+     * ones. 0 disables caching of strings.
+     */
+    void SetMaxStrings(size_t count)
+    {
+        m_maxStrings = count;
+        TrimStrings(count);
+    }
+
+    size_t GetMaxStrings() const {
+        return m_maxStrings;
+    }
+
+    /*
+     * Drop the cached chunk of the file at path. The bytecode file, if any,
+     * is left alone; it is still checked against the source when loaded.
+     */
+    void Invalidate(const std::string &path)
+    {
+        auto it = m_files.find(path);
+        if (it != m_files.end())
+        {
+            luaL_unref(L, LUA_REGISTRYINDEX, it->second.ref);
+            m_files.erase(it);
+        }
+    }
+
+    /*
+     * Drop every cached chunk.
+     */
+    void Clear()
+    {
+        for (auto it = m_files.begin(); it != m_files.end(); ++it)
+        {
+            luaL_unref(L, LUA_REGISTRYINDEX, it->second.ref);
+        }
+        for (auto it = m_strings.begin(); it != m_strings.end(); ++it)
+        {
+            luaL_unref(L, LUA_REGISTRYINDEX, it->second.ref);
+        }
+        m_files.clear();
+        m_strings.clear();
+        m_stringOrder.clear();
+    }
+
+    size_t Size() const {
+        return m_files.size() + m_strings.size();
+    }
+
+    const ChunkCacheStats& GetStats() const {
+        return m_stats;
+    }
+
+    void ResetStats() {
+        m_stats = ChunkCacheStats();
+    }
+
+    const std::string& GetBytecodeDirectory() const {
+        return m_bytecodeDir;
+    }
+
+private:
+    /*
+     * Drop the least recently used string chunks until at most count remain.
+     */
+    void TrimStrings(size_t count)
+    {
+        while (m_strings.size() > count)
+        {
+            auto it = m_strings.find(*m_stringOrder.back());
+            luaL_unref(L, LUA_REGISTRYINDEX, it->second.ref);
+            m_stringOrder.pop_back();
+            m_strings.erase(it);
+            ++m_stats.evictions;
+        }
+    }
+
+    /*
+     * Header written in front of the dumped chunk, identifying the source
+     * revision it was compiled from.
+     */
+    struct BytecodeHeader {
+        char magic[4];
+        long long mtime;
+        long long size;
+    };
+
+    std::string BytecodePath(const std::string &path) const
+    {
+        // FNV-1a of the source path keeps the cache directory flat.
+        unsigned long long hash = 14695981039346656037ull;
+        for (size_t i = 0; i < path.size(); ++i)
+        {
+            hash ^= static_cast<unsigned char>(path[i]);
+            hash *= 1099511628211ull;
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.luac", hash);
+        return m_bytecodeDir + "/" + name;
+    }
+
+    bool LoadBytecode(const std::string &path, long long mtime, long long size)
+    {
+        if (m_bytecodeDir.empty())
+        {
+            return false;
+        }
+
+        std::ifstream in(BytecodePath(path).c_str(), std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        BytecodeHeader header;
+        if (data.size() > sizeof(header))
+        {
+            memcpy(&header, data.data(), sizeof(header));
+            if (memcmp(header.magic, "LPBC", 4) == 0 && header.mtime == mtime && header.size == size)
+            {
+                const std::string chunkname = "@" + path;
+                if (luaL_loadbuffer(L, data.data() + sizeof(header), data.size() - sizeof(header), chunkname.c_str()) == LUAPORTAL_LUA_OK)
+                {
+                    ++m_stats.bytecodeHits;
+                    return true;
+                }
+                // Stale or foreign bytecode(e.g. another Lua build), recompile.
+                lua_pop(L, 1);
+            }
+        }
+        ++m_stats.bytecodeMisses;
+        return false;
+    }
+
+    static int DumpWriter(lua_State*, const void *p, size_t sz, void *ud)
+    {
+        static_cast<std::string*>(ud)->append(static_cast<const char*>(p), sz);
+        return 0;
+    }
+
+    /*
+     * Dump the function on top of the stack into the bytecode directory.
+     */
+    void SaveBytecode(const std::string &path, long long mtime, long long size)
+    {
+        if (m_bytecodeDir.empty())
+        {
+            return;
+        }
+
+        BytecodeHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "LPBC", 4);
+        header.mtime = mtime;
+        header.size = size;
+
+        std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+#if LUA_VERSION_NUM >= 503
+        const int failed = lua_dump(L, &DumpWriter, &data, 0);
+#else
+        const int failed = lua_dump(L, &DumpWriter, &data);
+#endif
+        if (failed)
+        {
+            return;
+        }
+
+        std::ofstream out(BytecodePath(path).c_str(), std::ios::binary | std::ios::trunc);
+        if (out.write(data.data(), data.size()))
+        {
+            ++m_stats.bytecodeWrites;
+        }
+    }
+
+    /*
+     * Copy is not allowed.
+     */
+    ChunkCache(const ChunkCache &other);
+    ChunkCache& operator=(const ChunkCache &rhs);
+
+};
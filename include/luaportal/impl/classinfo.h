@@ -1,3 +1,84 @@
+/** Compact identification of a registered class and its ancestors.
+ 
+ The record holds the class keys of the class and all its bases, ordered
+ from the root of the hierarchy down to the class itself. A class at depth d
+ is an ancestor of(or the same as) another class exactly when the other
+ display has more than d entries and entry d is the key of the first class,
+ so the test is one size compare and one pointer compare.
+ 
+ Userdata carries a pointer to the record of its dynamic class, which lets
+ Userdata::Get validate an object without touching any Lua table.
+ 
+ There is one record per C++ class, shared by every lua_State. It is built
+ by ClassInfo once, on the first registration of the class, and is never
+ changed afterwards, so it can be read from any thread.
+ */
+class ClassRecord
+{
+public:
+    typedef void (*DestroyFunction)(void*);
+    
+private:
+    template<typename T>
+    friend class ClassInfo;
+    
+    std::vector<void const*> m_display;
+    DestroyFunction m_destroy;
+    
+    ClassRecord()
+    : m_destroy(0)
+    {
+    }
+    
+    ClassRecord(ClassRecord const&);
+    ClassRecord& operator=(ClassRecord const&);
+    
+    /** Make this the record of a root class identified by classKey.
+     */
+    void SetRoot(void const* classKey)
+    {
+        m_display.assign(1, classKey);
+    }
+    
+    /** Make this the record of a class derived from parent.
+     */
+    void SetParent(ClassRecord const& parent, void const* classKey)
+    {
+        m_display = parent.m_display;
+        m_display.push_back(classKey);
+    }
+    
+    /** Set the function which runs the destructor of an object of the class
+     held by value in a userdata.
+     */
+    void SetDestroy(DestroyFunction destroy)
+    {
+        m_destroy = destroy;
+    }
+    
+public:
+    void Destroy(void* p) const
+    {
+        assert(m_destroy != 0);
+        m_destroy(p);
+    }
+    
+    bool IsRegistered() const
+    {
+        return !m_display.empty();
+    }
+    
+    /** Returns true if this class is base or is derived from base.
+     */
+    bool IsA(ClassRecord const& base) const
+    {
+        size_t const depth = base.m_display.size();
+        return depth != 0
+            && m_display.size() >= depth
+            && m_display [depth - 1] == base.m_display [depth - 1];
+    }
+};
+
 /** Unique Lua registry keys for a class.
  
  Each registered class inserts three keys into the registry, whose
@@ -41,5 +122,68 @@ public:
         static char Value;
         return &Value;
     }
+    
+    /** Get the record used for the fast type check of userdata.
+     */
+    static ClassRecord const& GetRecord()
+    {
+        return Record();
+    }
+    
+    /** Build the record of a root class.
+     
+     The record is shared by all lua_States, so only the first registration
+     of the class builds it, later registrations in other states leave it
+     untouched.
+     */
+    static void RegisterRoot()
+    {
+        std::call_once(RecordFlag(), []()
+        {
+            Record().SetRoot(GetClassKey());
+            Record().SetDestroy(GetDestroy(std::is_destructible<T>()));
+        });
+    }
+    
+    /** Build the record of a class derived from parent.
+     */
+    static void RegisterDerived(ClassRecord const& parent)
+    {
+        std::call_once(RecordFlag(), [&parent]()
+        {
+            Record().SetParent(parent, GetClassKey());
+            Record().SetDestroy(GetDestroy(std::is_destructible<T>()));
+        });
+    }
+    
+private:
+    static ClassRecord& Record()
+    {
+        static ClassRecord Value;
+        return Value;
+    }
+    
+    static std::once_flag& RecordFlag()
+    {
+        static std::once_flag Value;
+        return Value;
+    }
+    
+    /** Run the destructor of a T held by value in a userdata.
+     */
+    static void DestroyObject(void* p)
+    {
+        static_cast<T*>(p)->~T();
+    }
+    
+    static ClassRecord::DestroyFunction GetDestroy(std::true_type)
+    {
+        return &DestroyObject;
+    }
+    
+    static ClassRecord::DestroyFunction GetDestroy(std::false_type)
+    {
+        return 0;
+    }
 };
 
@@ -27,26 +27,39 @@ struct NewData<T,void *,P...> {
     }
 };
 
+/**
+ Construct a T from the arguments at stack index start and up.
+ */
 template<typename T, typename... P>
-struct RecursiveNewData;
-
-template<typename T>
-struct RecursiveNewData<T>{
-    template<typename... U>
-    static T* Call(lua_State *L, int start, U... u)
+struct ApplyNewData
+{
+    static T* Call(lua_State *L, int start)
     {
-        return NewData<T, U...>::Call(u...);
+        return Call(L, start, typename MakeIndexSequence<sizeof...(P)>::Type());
     }
-};
-
-template<typename T,typename H, typename... P>
-struct RecursiveNewData<T, H, P...>{
-    template<typename... U>
-    static T* Call(lua_State *L,int start, U... u)
+    
+    static T* Call(lua_State *L, int start, void* mem)
+    {
+        return Call(L, start, mem, typename MakeIndexSequence<sizeof...(P)>::Type());
+    }
+    
+private:
+    template<size_t... I>
+    static T* Call(lua_State *L, int start, IndexSequence<I...>)
+    {
+        (void)L;
+        (void)start;
+        typename StackArgs<P...>::Type args{Stack<P>::Get(L, start + static_cast<int>(I))...};
+        return new T(std::get<I>(std::move(args))...);
+    }
+    
+    template<size_t... I>
+    static T* Call(lua_State *L, int start, void* mem, IndexSequence<I...>)
     {
-        const int index = static_cast<int>(start + sizeof...(u));
-        H h = Stack<H>::Get(L, index);
-        return RecursiveNewData<T, P...>::Call(L,start, u..., h);
+        (void)L;
+        (void)start;
+        typename StackArgs<P...>::Type args{Stack<P>::Get(L, start + static_cast<int>(I))...};
+        return new(mem) T(std::get<I>(std::move(args))...);
     }
 };
 
@@ -54,14 +67,14 @@ template<typename C, typename... P>
 struct ConstructorFunc {
     static int placementProxy(lua_State* L) {
         auto place = UserdataValue<C>::place(L);
-        RecursiveNewData<C, P...>::Call(L, 1, place->GetVoidPointer());
+        ApplyNewData<C, P...>::Call(L, 2, place->GetVoidPointer());
         place->markConstructed();
         return 1;
     }
     
     static int containerProxy(lua_State* L) {
         typedef typename ContainerTraits<C>::Type T;
-        T* const p = RecursiveNewData<T, P...>::Call(L, 2);
+        T* const p = ApplyNewData<T, P...>::Call(L, 2);
         UserdataSharedHelper<C, false>::Push(L, p);
         return 1;
     }
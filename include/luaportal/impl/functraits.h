@@ -31,30 +31,63 @@ struct FuncTraits
 {
 };
 
-/* Ordinary function pointers. */
+//==============================================================================
+/**
+ A compile time sequence of indices(std::index_sequence is C++14).
+ 
+ Used to expand a parameter pack into the matching Lua stack indices, so
+ that every argument is read from the stack exactly once.
+ */
+template<size_t... I>
+struct IndexSequence
+{
+};
 
-template<typename R, typename D, typename... P>
-struct RecursiveCallStaticFunction;
+template<size_t N, size_t... I>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, I...>
+{
+};
 
-template<typename R, typename D, typename... P>
-struct RecursiveCallStaticFunction
+template<size_t... I>
+struct MakeIndexSequence<0, I...>
 {
-    template<typename... U>
-    static R Call(D fp, lua_State *L, U... u)
-    {
-        return fp(u...);
-    }
+    typedef IndexSequence<I...> Type;
 };
 
-template<typename R, typename D, typename H, typename... P>
-struct RecursiveCallStaticFunction<R,D,H,P...>
+/**
+ The arguments of a call, as read from the Lua stack.
+ 
+ The order in which function arguments are evaluated is unspecified(GCC
+ goes right to left), but the initializers of a braced list run left to
+ right. The arguments are read into a braced Type first and then passed on
+ with std::get, so the stack is always read from the first argument up.
+ */
+template<typename... P>
+struct StackArgs
 {
-    template<typename... U>
-    static R Call(D fp, lua_State *L, U... u)
+    typedef std::tuple<decltype(Stack<P>::Get(static_cast<lua_State*>(0), 0))...> Type;
+};
+
+/* Ordinary function pointers. */
+
+/**
+ Call a function pointer with the arguments at stack index 1 and up.
+ */
+template<typename R, typename D, typename... P>
+struct ApplyStaticFunction
+{
+    static R Call(D fp, lua_State *L)
+    {
+        return Call(fp, L, typename MakeIndexSequence<sizeof...(P)>::Type());
+    }
+    
+private:
+    template<size_t... I>
+    static R Call(D fp, lua_State *L, IndexSequence<I...>)
     {
-        const int index = static_cast<int>(1 + sizeof...(u));
-        H h = Stack<H>::Get(L, index);
-        return RecursiveCallStaticFunction<R,D,P...>::Call(fp, L, u..., h);
+        (void)L;
+        typename StackArgs<P...>::Type args{Stack<P>::Get(L, static_cast<int>(1 + I))...};
+        return fp(std::get<I>(std::move(args))...);
     }
 };
 
@@ -67,49 +100,45 @@ struct FuncTraits<R(*)(Param...), D>
     
     static R Call(D fp, lua_State *L)
     {
-        return RecursiveCallStaticFunction<R, D, Param...>::Call(fp, L);
+        return ApplyStaticFunction<R, D, Param...>::Call(fp, L);
     }
 };
 
 
 /* Non-const member function pointers. */
 
+/**
+ Call a member function pointer with the arguments at stack index 2 and up,
+ index 1 holds the object.
+ */
 template<typename T, typename R, typename D, typename... P>
-struct RecursiveCallMemberFunction;
-
-template<typename T, typename R, typename D, typename... P>
-struct RecursiveCallMemberFunction
+struct ApplyMemberFunction
 {
-    template<typename... U>
-    static R Call(T* obj, D fp, lua_State *L, U... u)
+    static R Call(T* obj, D fp, lua_State *L)
     {
-        return(obj->*fp)(u...);
+        return Call(obj, fp, L, typename MakeIndexSequence<sizeof...(P)>::Type());
     }
     
-    template<typename... U>
-    static R CallConst(const T* obj, D fp, lua_State *L, U... u)
+    static R CallConst(const T* obj, D fp, lua_State *L)
     {
-        return(obj->*fp)(u...);
+        return CallConst(obj, fp, L, typename MakeIndexSequence<sizeof...(P)>::Type());
     }
-};
-
-template<typename T, typename R, typename D, typename H, typename... P>
-struct RecursiveCallMemberFunction<T,R,D,H,P...>
-{
-    template<typename... U>
-    static R Call(T* obj, D fp, lua_State *L, U... u)
+    
+private:
+    template<size_t... I>
+    static R Call(T* obj, D fp, lua_State *L, IndexSequence<I...>)
     {
-        const int index = static_cast<int>(2 + sizeof...(u));
-        H h = Stack<H>::Get(L, index);
-        return RecursiveCallMemberFunction<T,R,D,P...>::Call(obj, fp, L, u..., h);
+        (void)L;
+        typename StackArgs<P...>::Type args{Stack<P>::Get(L, static_cast<int>(2 + I))...};
+        return(obj->*fp)(std::get<I>(std::move(args))...);
     }
     
-    template<typename... U>
-    static R CallConst(const T* obj, D fp, lua_State *L, U... u)
+    template<size_t... I>
+    static R CallConst(const T* obj, D fp, lua_State *L, IndexSequence<I...>)
     {
-        const int index = static_cast<int>(2 + sizeof...(u));
-        H h = Stack<H>::Get(L, index);
-        return RecursiveCallMemberFunction<T,R,D,P...>::CallConst(obj, fp, L, u..., h);
+        (void)L;
+        typename StackArgs<P...>::Type args{Stack<P>::Get(L, static_cast<int>(2 + I))...};
+        return(obj->*fp)(std::get<I>(std::move(args))...);
     }
 };
 
@@ -124,7 +153,7 @@ struct FuncTraits<R(T::*)(Param...), D>
     
     static R Call(T* obj, D fp, lua_State *L)
     {
-        return RecursiveCallMemberFunction<T, R, D, Param...>::Call(obj, fp, L);
+        return ApplyMemberFunction<T, R, D, Param...>::Call(obj, fp, L);
     }
 };
 
@@ -141,7 +170,7 @@ struct FuncTraits<R(T::*)(Param...) const, D>
     
     static R Call(const T* obj, D fp, lua_State *L)
     {
-        return RecursiveCallMemberFunction<T, R, D, Param...>::CallConst(obj, fp, L);
+        return ApplyMemberFunction<T, R, D, Param...>::CallConst(obj, fp, L);
     }
 };
 
@@ -158,7 +187,7 @@ struct FuncTraits<R(*)(Param...) LUAPORTAL_THROWSPEC, D>
     
     static R Call(D fp, lua_State *L)
     {
-        return RecursiveCallStaticFunction<R, D, Param...>::Call(fp, L);
+        return ApplyStaticFunction<R, D, Param...>::Call(fp, L);
     }
 };
 
@@ -175,7 +204,7 @@ struct FuncTraits<R(T::*)(Param...) LUAPORTAL_THROWSPEC, D>
     
     static R Call(T* obj, D fp, lua_State *L)
     {
-        return RecursiveCallMemberFunction<T, R, D, Param...>::Call(obj, fp, L);
+        return ApplyMemberFunction<T, R, D, Param...>::Call(obj, fp, L);
     }
 };
 
@@ -192,7 +221,7 @@ struct FuncTraits<R(T::*)(Param...) const LUAPORTAL_THROWSPEC, D>
     
     static R Call(const T* obj, D fp, lua_State *L)
     {
-        return RecursiveCallMemberFunction<T, R, D, Param...>::CallConst(obj, fp, L);
+        return ApplyMemberFunction<T, R, D, Param...>::CallConst(obj, fp, L);
     }
 };
 
@@ -1,4 +1,7 @@
 /** Allows table iteration.
+ 
+ The key and value are held as registry references. For traversals that
+ only read the entries, Pairs and IPairs below avoid the references.
  */
 class Iterator
 {
@@ -14,8 +17,8 @@ private:
         m_key.Push();
         if(lua_next(m_L, -2))
         {
-            m_value.Pop();
-            m_key.Pop();
+            m_value.Replace();
+            m_key.Replace();
         }
         else
         {
@@ -71,12 +74,12 @@ public:
         return m_key.IsNil();
     }
     
-    inline LuaRef Key() const
+    inline LuaRef const& Key() const
     {
         return m_key;
     }
     
-    inline LuaRef Value() const
+    inline LuaRef const& Value() const
     {
         return m_value;
     }
@@ -86,3 +89,330 @@ private:
     Iterator operator++(int);
 };
 
+
+//==============================================================================
+/** A key / value pair on the Lua stack, as seen by a Pairs traversal.
+ 
+ The values are read directly from the stack, no reference is created.
+ */
+class TableEntry
+{
+private:
+    friend class Pairs;
+    
+    lua_State* m_L;
+    int m_key; // the value is just above the key
+    
+    TableEntry(lua_State* L, int key)
+    : m_L(L)
+    , m_key(key)
+    {
+    }
+    
+public:
+    /** Read the key as T.
+     
+     The key is converted from a copy, a conversion in place(e.g. number
+     to string) would break the traversal.
+     */
+    template<typename T>
+    T Key() const
+    {
+        lua_pushvalue(m_L, m_key);
+        T t = Stack<T>::Get(m_L, -1);
+        lua_pop(m_L, 1);
+        return t;
+    }
+    
+    template<typename T>
+    T Value() const
+    {
+        return Stack<T>::Get(m_L, m_key + 1);
+    }
+    
+    int KeyType() const
+    {
+        return lua_type(m_L, m_key);
+    }
+    
+    int ValueType() const
+    {
+        return lua_type(m_L, m_key + 1);
+    }
+    
+    /** Stack index of the value, for nested traversals.
+     */
+    int ValueIndex() const
+    {
+        return m_key + 1;
+    }
+};
+
+//==============================================================================
+/** Range-for traversal of all entries of a table with lua_next.
+ 
+ The table, the current key and value are kept on the stack for the
+ duration of the traversal, so no registry reference is created. The loop
+ body must leave the stack as it found it, and the stack top is restored
+ when the range is destroyed(also after a break).
+ 
+ e.g. @code
+ for(auto const& entry : Pairs(table))
+ {
+     std::string name = entry.Key<std::string>();
+     int value = entry.Value<int>();
+ }
+ @endcode
+ */
+class Pairs
+{
+private:
+    lua_State* m_L;
+    int m_table;
+    int m_restore;
+    
+    Pairs(Pairs const&);
+    Pairs& operator=(Pairs const&);
+    
+public:
+    class iterator
+    {
+    private:
+        friend class Pairs;
+        
+        TableEntry m_entry;
+        int m_table;
+        bool m_end;
+        
+        iterator(lua_State* L, int table, bool end)
+        : m_entry(L, table + 1)
+        , m_table(table)
+        , m_end(end)
+        {
+        }
+        
+        void Next()
+        {
+            if(!lua_next(m_entry.m_L, m_table))
+            {
+                m_end = true;
+            }
+        }
+        
+    public:
+        TableEntry const& operator*() const
+        {
+            return m_entry;
+        }
+        
+        TableEntry const* operator->() const
+        {
+            return &m_entry;
+        }
+        
+        iterator& operator++()
+        {
+            lua_pop(m_entry.m_L, 1); // pop the value, keep the key
+            Next();
+            return *this;
+        }
+        
+        bool operator!=(iterator const& other) const
+        {
+            return m_end != other.m_end;
+        }
+    };
+    
+    explicit Pairs(LuaRef const& table)
+    : m_L(table.GetState())
+    , m_table(0)
+    , m_restore(lua_gettop(table.GetState()))
+    {
+        table.Push();
+        m_table = lua_gettop(m_L);
+    }
+    
+    Pairs(lua_State* L, int index)
+    : m_L(L)
+    , m_table(0)
+    , m_restore(lua_gettop(L))
+    {
+        lua_pushvalue(L, index);
+        m_table = lua_gettop(L);
+    }
+    
+    ~Pairs()
+    {
+        lua_settop(m_L, m_restore);
+    }
+    
+    /** Start the traversal, it can only be done once per range.
+     */
+    iterator begin()
+    {
+        lua_settop(m_L, m_table);
+        if(!lua_istable(m_L, m_table))
+        {
+            return end();
+        }
+        lua_pushnil(m_L);
+        iterator it(m_L, m_table, false);
+        it.Next();
+        return it;
+    }
+    
+    iterator end()
+    {
+        return iterator(m_L, m_table, true);
+    }
+};
+
+//==============================================================================
+/** An element of the array part of a table, as seen by an IPairs traversal.
+ */
+class ArrayEntry
+{
+private:
+    friend class IPairs;
+    
+    lua_State* m_L;
+    int m_index;
+    
+    ArrayEntry(lua_State* L, int index)
+    : m_L(L)
+    , m_index(index)
+    {
+    }
+    
+public:
+    /** The array index, starting at 1.
+     */
+    int Index() const
+    {
+        return m_index;
+    }
+    
+    template<typename T>
+    T Value() const
+    {
+        return Stack<T>::Get(m_L, -1);
+    }
+    
+    int ValueType() const
+    {
+        return lua_type(m_L, -1);
+    }
+};
+
+//==============================================================================
+/** Range-for traversal of t[1] .. t[#t] with lua_rawgeti.
+ 
+ The length is taken once with lua_rawlen, and elements are read without
+ invoking metamethods. The same stack rules as for Pairs apply; the current
+ element is on top of the stack.
+ */
+class IPairs
+{
+private:
+    lua_State* m_L;
+    int m_table;
+    int m_restore;
+    int m_size;
+    
+    IPairs(IPairs const&);
+    IPairs& operator=(IPairs const&);
+    
+    void Init()
+    {
+        m_table = lua_gettop(m_L);
+        m_size = lua_istable(m_L, m_table) ? static_cast<int>(lua_rawlen(m_L, m_table)) : 0;
+    }
+    
+public:
+    class iterator
+    {
+    private:
+        friend class IPairs;
+        
+        ArrayEntry m_entry;
+        int m_table;
+        
+        iterator(lua_State* L, int table, int index)
+        : m_entry(L, index)
+        , m_table(table)
+        {
+        }
+        
+    public:
+        ArrayEntry const& operator*() const
+        {
+            return m_entry;
+        }
+        
+        ArrayEntry const* operator->() const
+        {
+            return &m_entry;
+        }
+        
+        iterator& operator++()
+        {
+            lua_pop(m_entry.m_L, 1);
+            ++m_entry.m_index;
+            lua_rawgeti(m_entry.m_L, m_table, m_entry.m_index);
+            return *this;
+        }
+        
+        bool operator!=(iterator const& other) const
+        {
+            return m_entry.m_index != other.m_entry.m_index;
+        }
+    };
+    
+    explicit IPairs(LuaRef const& table)
+    : m_L(table.GetState())
+    , m_table(0)
+    , m_restore(lua_gettop(table.GetState()))
+    , m_size(0)
+    {
+        table.Push();
+        Init();
+    }
+    
+    IPairs(lua_State* L, int index)
+    : m_L(L)
+    , m_table(0)
+    , m_restore(lua_gettop(L))
+    , m_size(0)
+    {
+        lua_pushvalue(L, index);
+        Init();
+    }
+    
+    ~IPairs()
+    {
+        lua_settop(m_L, m_restore);
+    }
+    
+    int Size() const
+    {
+        return m_size;
+    }
+    
+    /** Start the traversal, it can only be done once per range.
+     */
+    iterator begin()
+    {
+        lua_settop(m_L, m_table);
+        if(m_size == 0)
+        {
+            return end();
+        }
+        lua_rawgeti(m_L, m_table, 1);
+        return iterator(m_L, m_table, 1);
+    }
+    
+    iterator end()
+    {
+        return iterator(m_L, m_table, m_size + 1);
+    }
+};
@@ -55,6 +55,11 @@ inline int get_length(lua_State* L, int idx)
     return int(lua_objlen(L, idx));
 }
 
+inline size_t lua_rawlen(lua_State* L, int idx)
+{
+    return lua_objlen(L, idx);
+}
+
 #else
 inline int get_length(lua_State* L, int idx)
 {
@@ -93,6 +98,48 @@ inline void rawsetfield(lua_State* L, int index, char const* key)
     lua_rawset(L, index);
 }
 
+/** Internal slots of the registration tables.
+ 
+ The slots are stored under light userdata keys rather than strings such as
+ "__propget", so the metamethods that read them on every access never hash
+ a C string, and scripts cannot reach them by name.
+ */
+enum MetaKey
+{
+    PropGetKey,
+    PropSetKey,
+    ParentKey,
+    ConstKey,
+    ClassKey,
+    TypeKey,
+    CacheKey,
+    ExtensibleKey,
+    MetaKeyCount
+};
+
+inline void* GetMetaKey(MetaKey key)
+{
+    static char keys [MetaKeyCount];
+    return &keys [key];
+}
+
+/** Get an internal slot of a registration table.
+ */
+inline void rawgetkey(lua_State* L, int index, MetaKey key)
+{
+    assert(lua_istable(L, index));
+    lua_rawgetp(L, index, GetMetaKey(key));
+}
+
+/** Set an internal slot of a registration table to the value on top of the
+ stack, which is popped.
+ */
+inline void rawsetkey(lua_State* L, int index, MetaKey key)
+{
+    assert(lua_istable(L, index));
+    lua_rawsetp(L, index, GetMetaKey(key));
+}
+
 /** Returns true if the value is a full userdata(not light).
  */
 inline bool isfulluserdata(lua_State* L, int index)
@@ -113,17 +160,141 @@ inline bool equalstates(lua_State* L1, lua_State* L2)
     lua_topointer(L2, LUA_REGISTRYINDEX);
 }
 
+/*
+ * Push the table of globals.
+ */
+inline void luaS_pushglobaltable(lua_State* L) {
+#if LUA_VERSION_NUM >= 502
+    lua_pushglobaltable(L);
+#else
+    lua_pushvalue(L, LUA_GLOBALSINDEX);
+#endif
+}
+
+/*
+ * Create a full userdata with room for nuvalue user values.
+ *
+ * Lua 5.4 sizes the block for the user values, so userdata which never gets
+ * one is created with nuvalue 0. Earlier versions always have a single user
+ * value(5.2, 5.3) or none at all(5.1, see luaS_getuservalue), nuvalue only
+ * matters for 5.4 there.
+ */
+inline void* luaS_newuserdata(lua_State* L, size_t size, int nuvalue) {
+#if LUA_VERSION_NUM >= 504
+    return lua_newuserdatauv(L, size, nuvalue);
+#else
+    (void)nuvalue;
+    return lua_newuserdata(L, size);
+#endif
+}
+
+#if LUA_VERSION_NUM < 502
+/*
+ * Lua 5.1 has no user values, they are kept in a weak keyed registry table.
+ */
+inline void* luaS_uservaluekey() {
+    static char key;
+    return &key;
+}
+#endif
+
+/*
+ * Push the user value of the userdata at index, nil if it has none.
+ */
+inline void luaS_getuservalue(lua_State* L, int index) {
+#if LUA_VERSION_NUM >= 504
+    lua_getiuservalue(L, index, 1);
+#elif LUA_VERSION_NUM >= 502
+    lua_getuservalue(L, index);
+#else
+    index = lua_absindex(L, index);
+    lua_rawgetp(L, LUA_REGISTRYINDEX, luaS_uservaluekey());
+    if (lua_istable(L, -1)) {
+        lua_pushvalue(L, index);
+        lua_rawget(L, -2);
+        lua_remove(L, -2);
+    }
+    else {
+        lua_pop(L, 1);
+        lua_pushnil(L);
+    }
+#endif
+}
+
+/*
+ * Pop a value from the stack and make it the user value of the userdata at
+ * index. Returns false if the userdata was created without a user value.
+ */
+inline bool luaS_setuservalue(lua_State* L, int index) {
+#if LUA_VERSION_NUM >= 504
+    return lua_setiuservalue(L, index, 1) != 0;
+#elif LUA_VERSION_NUM >= 502
+    lua_setuservalue(L, index);
+    return true;
+#else
+    index = lua_absindex(L, index);
+    lua_rawgetp(L, LUA_REGISTRYINDEX, luaS_uservaluekey());
+    if (!lua_istable(L, -1)) {
+        lua_pop(L, 1);
+        lua_createtable(L, 0, 1);
+        lua_createtable(L, 0, 1);
+        lua_pushstring(L, "k");
+        lua_setfield(L, -2, "__mode");
+        lua_setmetatable(L, -2);
+        lua_pushvalue(L, -1);
+        lua_rawsetp(L, LUA_REGISTRYINDEX, luaS_uservaluekey());
+    }
+    lua_pushvalue(L, index);
+    lua_pushvalue(L, -3);
+    lua_rawset(L, -3);
+    lua_pop(L, 2);
+    return true;
+#endif
+}
+
 inline lua_State* luaS_newstate() {
     lua_State *L = luaL_newstate();
     luaL_openlibs(L);
     return L;
 }
 
+inline int luaS_panic(lua_State* L) {
+    fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", lua_tostring(L, -1));
+    return 0;
+}
+
+/*
+ * Create a state using a custom allocator, with the same setup as
+ * luaS_newstate().
+ */
+inline lua_State* luaS_newstate(lua_Alloc f, void* ud) {
+    lua_State *L = lua_newstate(f, ud);
+    if (L) {
+        lua_atpanic(L, &luaS_panic);
+        luaL_openlibs(L);
+    }
+    return L;
+}
+
 
 inline void luaS_close(lua_State* L) {
     lua_close(L);
 }
 
+/*
+ * Push a traceback of the stack of L, starting at the calling function.
+ */
+inline void luaS_traceback(lua_State* L) {
+#if LUA_VERSION_NUM >= 502
+    luaL_traceback(L, L, NULL, 1);
+#else
+    lua_getglobal(L, "debug");
+    lua_getfield(L, -1, "traceback");
+    lua_remove(L, -2);
+    lua_pcall(L, 0, 1, 0);
+#endif
+}
+
 /*
  * Push t[key] onto the stack, where t is the value at the top of the stack.
  * Bypassing metamethods.
@@ -178,7 +349,7 @@ inline void luaS_rawseti(lua_State* L, int index, char const* key) {
 template<typename T>
 inline void Push(lua_State* L, T t)
 {
-    Stack<T>::Push(L, t);
+    Stack<T>::Push(L, std::forward<T>(t));
 }
 
 //------------------------------------------------------------------------------
@@ -191,7 +362,7 @@ inline void Push(lua_State* L, T t)
 template<typename T>
 inline void SetGlobal(lua_State* L, T t, char const* name)
 {
-    Push(L, t);
+    Push(L, std::forward<T>(t));
     lua_setglobal(L, name);
 }
 
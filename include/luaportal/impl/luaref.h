@@ -12,6 +12,9 @@ class LuaRef {
     class Proxy;
     friend class Proxy;
     friend class Iterator;
+    friend class Pairs;
+    friend class IPairs;
+    friend class StackRef;
     friend struct Stack<LuaRef> ;
     friend struct Stack<Proxy> ;
     friend std::ostream& operator<<(std::ostream&, LuaRef::Proxy const&);
@@ -274,6 +277,20 @@ private:
         m_ref = luaL_ref(L, LUA_REGISTRYINDEX);
     }
     
+    /*
+     * Pop the top of Lua stack into this ref, storing it in the registry
+     * slot already held instead of releasing it and taking a new one.
+     * nil still maps to LUA_REFNIL, as with luaL_ref.
+     */
+    void Replace() {
+        if(m_ref >= 0 && !lua_isnil(L, -1)) {
+            lua_rawseti(L, LUA_REGISTRYINDEX, m_ref);
+        }
+        else {
+            Pop();
+        }
+    }
+    
 public:
     explicit LuaRef(lua_State* L)
     : L(L),
@@ -292,6 +309,15 @@ public:
     m_ref(other.CreateRef()) {
     }
     
+    /*
+     * Take over the registry slot of other, which is left nil.
+     */
+    LuaRef(LuaRef&& other) noexcept
+    : L(other.L),
+    m_ref(other.m_ref) {
+        other.m_ref = LUA_REFNIL;
+    }
+    
     /*
      * Create a LuaRef from Proxy.
      * May invoke metamethods.
@@ -307,17 +333,25 @@ public:
     
     template<typename T>
     LuaRef& operator=(T rhs) {
-        luaL_unref(L, LUA_REGISTRYINDEX, m_ref);
-        Stack<T>::Push(L, rhs);
-        m_ref = luaL_ref(L, LUA_REGISTRYINDEX);
-        return *this;
+        return Assign(rhs);
     }
     
     LuaRef& operator=(LuaRef const& rhs) {
-        luaL_unref(L, LUA_REGISTRYINDEX, m_ref);
-        L = rhs.GetState();
-        rhs.Push();
-        m_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+        if(equalstates(L, rhs.GetState())) {
+            rhs.Push();
+            Replace();
+        }
+        else {
+            luaL_unref(L, LUA_REGISTRYINDEX, m_ref);
+            L = rhs.GetState();
+            m_ref = rhs.CreateRef();
+        }
+        return *this;
+    }
+    
+    LuaRef& operator=(LuaRef&& rhs) noexcept {
+        Swap(rhs);
+        rhs.Reset();
         return *this;
     }
     
@@ -325,12 +359,41 @@ public:
      * May invoke metamethod.
      */
     LuaRef& operator=(Proxy const& rhs) {
-        luaL_unref(L, LUA_REGISTRYINDEX, m_ref);
-        L = rhs.GetState();
-        m_ref = rhs.CreateRef();
+        if(equalstates(L, rhs.GetState())) {
+            rhs.Push();
+            Replace();
+        }
+        else {
+            luaL_unref(L, LUA_REGISTRYINDEX, m_ref);
+            L = rhs.GetState();
+            m_ref = rhs.CreateRef();
+        }
         return *this;
     }
     
+    /*
+     * Assign a value, reusing the registry slot held by this ref.
+     */
+    template<typename T>
+    LuaRef& Assign(T v) {
+        Stack<T>::Push(L, v);
+        Replace();
+        return *this;
+    }
+    
+    /*
+     * Release the registry slot, leaving this ref nil.
+     */
+    void Reset() {
+        luaL_unref(L, LUA_REGISTRYINDEX, m_ref);
+        m_ref = LUA_REFNIL;
+    }
+    
+    void Swap(LuaRef& other) noexcept {
+        std::swap(L, other.L);
+        std::swap(m_ref, other.m_ref);
+    }
+    
     std::string ToString() const {
         lua_getglobal(L, "tostring");
         Push();
@@ -454,10 +517,215 @@ public:
 };
 
 
+/*
+ * A non-owning view of a value on the Lua stack.
+ *
+ * Lookups through operator[] push the result onto the stack and return a
+ * new view of it, so chained access like
+ *
+ *     StackRef::GetGlobal(L, "config")["window"]["width"].Cast<int>()
+ *
+ * never touches the registry. Each view restores the stack top it found
+ * when it is destroyed, and a view obtained from a temporary takes over the
+ * stack slots of that temporary, so the chain above leaves the stack as it
+ * was. Named views must be destroyed in the reverse order of creation,
+ * which scoped locals do automatically.
+ *
+ * Use ToLuaRef() to keep the value beyond the scope of the view.
+ * NEVER use StackRef as a member/global/static variable.
+ */
+class StackRef {
+    
+private:
+    lua_State* L;
+    int m_index;
+    int m_restore; // stack top to restore, or -1 if the view owns no slot
+    
+    StackRef(lua_State* L, int index, int restore)
+    : L(L),
+    m_index(index),
+    m_restore(restore) {
+    }
+    
+    /*
+     * Copy is NOT allowed, a copy would restore the stack twice.
+     */
+    StackRef(StackRef const& other);
+    StackRef& operator=(StackRef const& other);
+    
+    /*
+     * Push the key and look it up, leaving the value on top.
+     */
+    template<typename K>
+    void PushField(K key, bool raw) const {
+        if(lua_istable(L, m_index) || (!raw && lua_isuserdata(L, m_index))) {
+            Stack<K>::Push(L, key);
+            if(raw) {
+                lua_rawget(L, m_index);
+            }
+            else {
+                lua_gettable(L, m_index); // This may trigger the "index" event.
+            }
+        }
+        else {
+            lua_pushnil(L);
+        }
+    }
+    
+public:
+    /*
+     * View the value at the given stack index without owning it.
+     */
+    StackRef(lua_State* L, int index)
+    : L(L),
+    m_index(lua_absindex(L, index)),
+    m_restore(-1) {
+    }
+    
+    /*
+     * Push the value of an owning reference and view it.
+     */
+    explicit StackRef(LuaRef const& ref)
+    : L(ref.GetState()),
+    m_index(0),
+    m_restore(lua_gettop(ref.GetState())) {
+        ref.Push();
+        m_index = lua_gettop(L);
+    }
+    
+    StackRef(StackRef&& other)
+    : L(other.L),
+    m_index(other.m_index),
+    m_restore(other.m_restore) {
+        other.m_restore = -1;
+    }
+    
+    ~StackRef() {
+        if(m_restore >= 0) {
+            lua_settop(L, m_restore);
+        }
+    }
+    
+    /*
+     * Push a global variable and view it.
+     */
+    static StackRef GetGlobal(lua_State* L, char const* name) {
+        int const top = lua_gettop(L);
+        lua_getglobal(L, name);
+        return StackRef(L, lua_gettop(L), top);
+    }
+    
+    lua_State* GetState() const { return L; }
+    
+    /*
+     * The absolute stack index of the viewed value.
+     */
+    int GetIndex() const { return m_index; }
+    
+    int GetType() const { return lua_type(L, m_index); }
+    
+    const char * TypeName() const {
+        return lua_typename(L, GetType());
+    }
+    
+    bool IsNil() const { return GetType() == LUA_TNIL; }
+    bool IsNumber() const { return GetType() == LUA_TNUMBER; }
+    bool IsString() const { return GetType() == LUA_TSTRING; }
+    bool IsTable() const { return GetType() == LUA_TTABLE; }
+    bool IsFunction() const { return GetType() == LUA_TFUNCTION; }
+    bool IsUserdata() const { return GetType() == LUA_TUSERDATA; }
+    bool IsThread() const { return GetType() == LUA_TTHREAD; }
+    bool IsLightUserdata() const { return GetType() == LUA_TLIGHTUSERDATA; }
+    
+    /*
+     * Explicit conversion.
+     * A StringRef result stays valid as long as this view.
+     */
+    template<typename T>
+    T Cast() const {
+        return Stack<T>::Get(L, m_index);
+    }
+    
+    int Length() const {
+        return get_length(L, m_index);
+    }
+    
+    /*
+     * Access to element table[key].
+     * May invoke metamethods.
+     */
+    template<typename K>
+    StackRef operator[](K key) const & {
+        int const top = lua_gettop(L);
+        PushField(key, false);
+        return StackRef(L, lua_gettop(L), top);
+    }
+    
+    /*
+     * Access to element table[key] of a temporary view.
+     * The result takes over the stack slots of this view.
+     */
+    template<typename K>
+    StackRef operator[](K key) && {
+        PushField(key, false);
+        StackRef v(L, lua_gettop(L), m_restore);
+        m_restore = -1;
+        return v;
+    }
+    
+    /*
+     * Access to element table[key] without invoking metamethods.
+     */
+    template<typename K>
+    StackRef RawGet(K key) const {
+        int const top = lua_gettop(L);
+        PushField(key, true);
+        return StackRef(L, lua_gettop(L), top);
+    }
+    
+    /*
+     * Assign table[key] = v.
+     * May invoke metamethods.
+     */
+    template<typename K, typename T>
+    void Set(K key, T v) const {
+        Stack<K>::Push(L, key);
+        Stack<T>::Push(L, v);
+        lua_settable(L, m_index); // This may trigger the "newindex" event
+    }
+    
+    /*
+     * Assign table[key] = v without invoking metamethods.
+     */
+    template<typename K, typename T>
+    void RawSet(K key, T v) const {
+        Stack<K>::Push(L, key);
+        Stack<T>::Push(L, v);
+        lua_rawset(L, m_index);
+    }
+    
+    /*
+     * Create an owning reference to the viewed value.
+     */
+    LuaRef ToLuaRef() const {
+        lua_pushvalue(L, m_index);
+        return LuaRef::PopLuaRef(L);
+    }
+};
+
+/*
+ * StackRef viewing a table, for readability at call sites.
+ */
+typedef StackRef TableView;
+
 inline LuaRef GetGlobal(lua_State* L, char const* name) {
     return LuaRef::GetGlobal(L, name);
 }
 
+inline void swap(LuaRef& a, LuaRef& b) noexcept {
+    a.Swap(b);
+}
+
 inline LuaRef getIndex(lua_State* L, int index) {
     return LuaRef::getindex(L, index);
 }
@@ -477,6 +745,14 @@ template<> struct Stack< LuaRef::Proxy > {
 };
 
 
+template<> struct Stack< StackRef > {
+    static void Push(lua_State* L, StackRef const& v) {
+        assert(equalstates(L, v.GetState()));
+        lua_pushvalue(L, v.GetIndex());
+    }
+};
+
+
 template<> struct Stack< LuaRef > {
     static void Push(lua_State* L, LuaRef const& v) {
         assert(equalstates(L, v.GetState()));
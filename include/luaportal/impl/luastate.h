@@ -3,7 +3,10 @@
 /* A wrapper for lua_State */
 class LuaState {
 private:
+    std::unique_ptr<LuaAllocator> m_allocator;
     lua_State *L;
+    std::unique_ptr<ChunkCache> m_chunkCache;
+    std::unique_ptr<MemoryTracker> m_memoryTracker;
     
 public:
         
@@ -11,7 +14,18 @@ public:
     : L(luaS_newstate()) {
     }
     
+    /*
+     * Create a state whose memory is served by allocator, e.g. a
+     * PoolAllocator or an ArenaAllocator. The state owns the allocator.
+     */
+    explicit LuaState(std::unique_ptr<LuaAllocator> allocator)
+    : m_allocator(std::move(allocator))
+    , L(luaS_newstate(m_allocator->GetFunction(), m_allocator.get())) {
+    }
+    
     ~LuaState() {
+        m_chunkCache.reset();
+        m_memoryTracker.reset();
         luaS_close(L);
     }
     
@@ -19,11 +33,18 @@ public:
         return L;
     }
     
+    LuaAllocator* GetAllocator() const {
+        return m_allocator.get();
+    }
+    
     void DoFile(const std::string &path) 
     {
         lua_pushcfunction(L, &ShowDebugMessage);
         auto debugfunc = lua_gettop(L);
-        luaL_loadfile(L, path.c_str());
+        if (m_chunkCache)
+            m_chunkCache->LoadFile(path);
+        else
+            luaL_loadfile(L, path.c_str());
         if (lua_pcall(L, 0, 0, debugfunc))
         {
             lua_pop(L, 1);
@@ -36,7 +57,10 @@ public:
     {
         lua_pushcfunction(L, &ShowDebugMessage);
         auto debugfunc = lua_gettop(L);
-        luaL_loadstring(L, content.c_str());
+        if (m_chunkCache)
+            m_chunkCache->LoadSource(content);
+        else
+            luaL_loadstring(L, content.c_str());
         if (lua_pcall(L, 0, 0, debugfunc))
         {
             lua_pop(L, 1);
@@ -44,6 +68,63 @@ public:
         lua_remove(L, debugfunc);
     }
     
+    /*
+     * Keep compiled chunks of DoFile and DoString for re-execution, and, if
+     * bytecodeDir is not empty, persist compiled files there as bytecode.
+     */
+    void EnableChunkCache(const std::string &bytecodeDir = std::string())
+    {
+        m_chunkCache.reset(new ChunkCache(L, bytecodeDir));
+    }
+    
+    void DisableChunkCache()
+    {
+        m_chunkCache.reset();
+    }
+    
+    ChunkCache* GetChunkCache() const {
+        return m_chunkCache.get();
+    }
+    
+    /*
+     * Record live and peak bytes, allocation counts and a block size
+     * histogram, and cap the state at limit bytes if limit is not 0.
+     */
+    void EnableMemoryTracking(size_t limit = 0)
+    {
+        if (!m_memoryTracker)
+            m_memoryTracker.reset(new MemoryTracker(L));
+        m_memoryTracker->SetLimit(limit);
+    }
+    
+    void DisableMemoryTracking()
+    {
+        m_memoryTracker.reset();
+    }
+    
+    /*
+     * Change the byte limit of a tracked state, 0 removes it.
+     */
+    void SetMemoryLimit(size_t limit)
+    {
+        EnableMemoryTracking(limit);
+    }
+    
+    /*
+     * The memory usage of the state. Without tracking only liveBytes is
+     * filled in, from the garbage collector's count.
+     */
+    LuaMemoryStats MemoryStats() const
+    {
+        if (m_memoryTracker)
+            return m_memoryTracker->GetStats();
+        
+        LuaMemoryStats stats;
+        stats.liveBytes = static_cast<size_t>(lua_gc(L, LUA_GCCOUNT, 0)) * 1024
+                        + static_cast<size_t>(lua_gc(L, LUA_GCCOUNTB, 0));
+        return stats;
+    }
+    
     void AddSearcher(lua_CFunction func)
     {
         luaS_addSearcher(L, func);
@@ -52,7 +133,7 @@ public:
     template<typename T>
     void SetGlobal(char const* name, T t)
     {
-        Push(L, t);
+        Push(L, std::forward<T>(t));
         lua_setglobal(L, name);
     }
     
@@ -0,0 +1,428 @@
+//==============================================================================
+/**
+ FNV-1a hash of a member name, usable in constant expressions.
+ */
+constexpr uint32_t MemberNameHash(char const* name, uint32_t hash = 2166136261u)
+{
+    return *name ? MemberNameHash(name + 1, (hash ^ static_cast<unsigned char>(*name)) * 16777619u) : hash;
+}
+
+/** The same hash over a string of known length, used for lookups.
+ 
+ Named apart from MemberNameHash: where size_t is 32 bits wide it is the
+ same type as the seed, and the two overloads would collide.
+ */
+inline uint32_t MemberNameHashN(char const* name, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i< length; ++i)
+    {
+        hash = (hash ^ static_cast<unsigned char>(name [i])) * 16777619u;
+    }
+    return hash;
+}
+
+constexpr size_t MemberNameLength(char const* name)
+{
+    return *name ? 1 + MemberNameLength(name + 1) : 0;
+}
+
+//==============================================================================
+/**
+ One member of a compile time member list.
+
+ Entries are made with the LUAPORTAL_METHOD, LUAPORTAL_FIELD and
+ LUAPORTAL_PROPERTY macros and passed to Class<T>::AddMembers() as an array.
+ The call thunks are template instantiations over the member pointer, so an
+ entry carries no per member data besides its name: the name hash and length
+ are computed at compile time, the function pointers are constants.
+
+ A function entry holds the lua_CFunction returned by __index. A property
+ entry holds a getter, called with the object at index 1, and a setter,
+ called with the object at index 1 and the value at index 2; the setter is
+ nullptr for read-only properties.
+ */
+struct MemberEntry
+{
+    enum Kind
+    {
+        Function,
+        ConstFunction,
+        Property
+    };
+
+    constexpr MemberEntry()
+    : name(nullptr)
+    , length(0)
+    , hash(0)
+    , kind(Function)
+    , get(nullptr)
+    , set(nullptr)
+    {
+    }
+
+    constexpr MemberEntry(char const* name, Kind kind, lua_CFunction get, lua_CFunction set)
+    : name(name)
+    , length(MemberNameLength(name))
+    , hash(MemberNameHash(name))
+    , kind(kind)
+    , get(get)
+    , set(set)
+    {
+    }
+
+    char const* name;
+    size_t length;
+    uint32_t hash;
+    Kind kind;
+    lua_CFunction get;
+    lua_CFunction set;
+};
+
+//==============================================================================
+/**
+ Call thunks for member functions, with the function pointer as a template
+ argument instead of a closure upvalue.
+ */
+template<typename MemFn, typename ReturnType = typename FuncTraits<MemFn>::ReturnType>
+struct MemberFunctionThunk
+{
+    typedef typename FuncTraits<MemFn>::ClassType T;
+    static bool const isConst = FuncTraits<MemFn>::IsConstMemberFunction;
+
+    template<MemFn fp>
+    static int Call(lua_State* L)
+    {
+        Stack<ReturnType>::Push(L, FuncTraits<MemFn>::Call(Userdata::Get<T>(L, 1, isConst), fp, L));
+        return 1;
+    }
+
+    template<MemFn fp>
+    static constexpr MemberEntry Entry(char const* name)
+    {
+        return MemberEntry(name, isConst ? MemberEntry::ConstFunction : MemberEntry::Function, &Call<fp>, nullptr);
+    }
+};
+
+template<typename MemFn>
+struct MemberFunctionThunk<MemFn, void>
+{
+    typedef typename FuncTraits<MemFn>::ClassType T;
+    static bool const isConst = FuncTraits<MemFn>::IsConstMemberFunction;
+
+    template<MemFn fp>
+    static int Call(lua_State* L)
+    {
+        FuncTraits<MemFn>::Call(Userdata::Get<T>(L, 1, isConst), fp, L);
+        return 0;
+    }
+
+    template<MemFn fp>
+    static constexpr MemberEntry Entry(char const* name)
+    {
+        return MemberEntry(name, isConst ? MemberEntry::ConstFunction : MemberEntry::Function, &Call<fp>, nullptr);
+    }
+};
+
+//------------------------------------------------------------------------------
+/**
+ Getter and setter thunks for data members. Const data members are read-only.
+ */
+template<typename MemberPtr>
+struct MemberDataThunk;
+
+template<typename C, typename U>
+struct MemberDataThunk<U C::*>
+{
+    template<U C::* mp>
+    static int Get(lua_State* L)
+    {
+        C const* const c = Userdata::Get<C>(L, 1, true);
+        Stack<U>::Push(L, c->*mp);
+        return 1;
+    }
+
+    template<U C::* mp>
+    static int Set(lua_State* L)
+    {
+        C* const c = Userdata::Get<C>(L, 1, false);
+        c->*mp = Stack<U>::Get(L, 2);
+        return 0;
+    }
+
+    template<U C::* mp>
+    static constexpr MemberEntry Entry(char const* name)
+    {
+        return MemberEntry(name, MemberEntry::Property, &Get<mp>, &Set<mp>);
+    }
+};
+
+template<typename C, typename U>
+struct MemberDataThunk<U const C::*>
+{
+    template<U const C::* mp>
+    static int Get(lua_State* L)
+    {
+        C const* const c = Userdata::Get<C>(L, 1, true);
+        Stack<U>::Push(L, c->*mp);
+        return 1;
+    }
+
+    template<U const C::* mp>
+    static constexpr MemberEntry Entry(char const* name)
+    {
+        return MemberEntry(name, MemberEntry::Property, &Get<mp>, nullptr);
+    }
+};
+
+//------------------------------------------------------------------------------
+/**
+ Getter and setter thunks for properties made of member functions.
+ */
+template<typename Getter>
+struct MemberGetterThunk;
+
+template<typename C, typename TG>
+struct MemberGetterThunk<TG(C::*)() const>
+{
+    template<TG(C::*get)() const>
+    static int Get(lua_State* L)
+    {
+        C const* const c = Userdata::Get<C>(L, 1, true);
+        Stack<TG>::Push(L, (c->*get)());
+        return 1;
+    }
+};
+
+template<typename Setter>
+struct MemberSetterThunk;
+
+template<typename C, typename TS>
+struct MemberSetterThunk<void(C::*)(TS)>
+{
+    template<void(C::*set)(TS)>
+    static int Set(lua_State* L)
+    {
+        C* const c = Userdata::Get<C>(L, 1, false);
+        (c->*set)(Stack<TS>::Get(L, 2));
+        return 0;
+    }
+};
+
+//==============================================================================
+/**
+ A perfect hash table over the entries of a member list.
+
+ The table is built once per class at registration, from the hashes computed
+ at compile time, with hash and displace: keys are grouped into buckets by
+ their hash, and each bucket, largest first, gets the first seed that sends
+ all its keys to free slots. A lookup is one hash of the key, one seed read
+ and one slot read, confirmed by comparing the name, so its cost does not
+ depend on the number of members.
+
+ The table lives in a full userdata without a metatable, laid out as the
+ header followed by the slots and the bucket seeds.
+ */
+class MemberDispatch
+{
+public:
+    //--------------------------------------------------------------------------
+    /**
+     Build the table for the entries and push it as a userdata. Later entries
+     replace earlier ones with the same name.
+     */
+    static void Push(lua_State* L, std::vector<MemberEntry> entries)
+    {
+        std::vector<MemberEntry> unique;
+        unique.reserve(entries.size());
+        for(size_t i = 0; i< entries.size(); ++i)
+        {
+            bool replaced = false;
+            for(size_t j = 0; j< unique.size(); ++j)
+            {
+                if(unique [j].hash == entries [i].hash)
+                {
+                    if(unique [j].length != entries [i].length ||
+                       memcmp(unique [j].name, entries [i].name, entries [i].length) != 0)
+                    {
+                        throw std::logic_error(std::string("member names '") + unique [j].name +
+                                               "' and '" + entries [i].name + "' have the same hash");
+                    }
+                    unique [j] = entries [i];
+                    replaced = true;
+                    break;
+                }
+            }
+            if(!replaced)
+                unique.push_back(entries [i]);
+        }
+
+        uint32_t const slotCount = PowerOfTwo(static_cast<uint32_t>(unique.size() + unique.size() / 4 + 1));
+        for(uint32_t bucketCount = PowerOfTwo(static_cast<uint32_t>(unique.size() / 4 + 1));; bucketCount *= 2)
+        {
+            std::vector<uint32_t> seeds(bucketCount, 0);
+            std::vector<int> slots(slotCount, -1);
+            if(Place(unique, seeds, slots))
+            {
+                size_t const size = sizeof(MemberDispatch) + slotCount * sizeof(MemberEntry) + bucketCount * sizeof(uint32_t);
+                MemberDispatch* const dispatch = static_cast<MemberDispatch*>(luaS_newuserdata(L, size, 0));
+                dispatch->m_slotMask = slotCount - 1;
+                dispatch->m_bucketMask = bucketCount - 1;
+                MemberEntry* const entryTable = dispatch->Slots();
+                for(uint32_t s = 0; s< slotCount; ++s)
+                {
+                    entryTable [s] = slots [s]< 0 ? MemberEntry() : unique [slots [s]];
+                }
+                std::copy(seeds.begin(), seeds.end(), dispatch->Seeds());
+                return;
+            }
+            if(bucketCount >= slotCount)
+                throw std::logic_error("cannot build the member hash table");
+        }
+    }
+
+    /** Find the entry for a key, nullptr if it is not a member. */
+    MemberEntry const* Find(char const* key, size_t length) const
+    {
+        uint32_t const hash = MemberNameHashN(key, length);
+        uint32_t const seed = Seeds() [hash & m_bucketMask];
+        MemberEntry const& entry = Slots() [Mix(hash ^ seed) & m_slotMask];
+        if(entry.hash == hash && entry.length == length && entry.name != nullptr &&
+           memcmp(entry.name, key, length) == 0)
+        {
+            return &entry;
+        }
+        return nullptr;
+    }
+
+    /** All entries, for merging with the entries of a later AddMembers(). */
+    void GetEntries(std::vector<MemberEntry>& entries) const
+    {
+        for(uint32_t s = 0; s <= m_slotMask; ++s)
+        {
+            if(Slots() [s].name != nullptr)
+                entries.push_back(Slots() [s]);
+        }
+    }
+
+private:
+    static uint32_t Mix(uint32_t h)
+    {
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        h *= 0xc2b2ae35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+    static uint32_t PowerOfTwo(uint32_t n)
+    {
+        uint32_t p = 1;
+        while(p< n)
+            p *= 2;
+        return p;
+    }
+
+    static bool Place(std::vector<MemberEntry> const& entries, std::vector<uint32_t>& seeds, std::vector<int>& slots)
+    {
+        uint32_t const bucketMask = static_cast<uint32_t>(seeds.size() - 1);
+        uint32_t const slotMask = static_cast<uint32_t>(slots.size() - 1);
+
+        std::vector<std::vector<int>> buckets(seeds.size());
+        for(size_t i = 0; i< entries.size(); ++i)
+        {
+            buckets [entries [i].hash & bucketMask].push_back(static_cast<int>(i));
+        }
+        std::vector<uint32_t> order(buckets.size());
+        for(uint32_t b = 0; b< order.size(); ++b)
+        {
+            order [b] = b;
+        }
+        std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+            return buckets [a].size() > buckets [b].size();
+        });
+
+        std::vector<uint32_t> placed;
+        for(size_t o = 0; o< order.size() && !buckets [order [o]].empty(); ++o)
+        {
+            std::vector<int> const& bucket = buckets [order [o]];
+            uint32_t seed = 0;
+            for(;; ++seed)
+            {
+                if(seed == 0x100000)
+                    return false;
+
+                placed.clear();
+                for(size_t k = 0; k< bucket.size(); ++k)
+                {
+                    uint32_t const slot = Mix(entries [bucket [k]].hash ^ seed) & slotMask;
+                    if(slots [slot] >= 0 || std::find(placed.begin(), placed.end(), slot) != placed.end())
+                        break;
+                    placed.push_back(slot);
+                }
+                if(placed.size() == bucket.size())
+                    break;
+            }
+            seeds [order [o]] = seed;
+            for(size_t k = 0; k< bucket.size(); ++k)
+            {
+                slots [placed [k]] = bucket [k];
+            }
+        }
+        return true;
+    }
+
+    MemberEntry* Slots()
+    {
+        return reinterpret_cast<MemberEntry*>(this + 1);
+    }
+
+    MemberEntry const* Slots() const
+    {
+        return reinterpret_cast<MemberEntry const*>(this + 1);
+    }
+
+    uint32_t* Seeds()
+    {
+        return reinterpret_cast<uint32_t*>(Slots() + m_slotMask + 1);
+    }
+
+    uint32_t const* Seeds() const
+    {
+        return reinterpret_cast<uint32_t const*>(Slots() + m_slotMask + 1);
+    }
+
+    uint32_t m_slotMask;
+    uint32_t m_bucketMask;
+};
+
+//------------------------------------------------------------------------------
+/**
+ Member list entries for Class<T>::AddMembers().
+
+ e.g. @code
+ static luaportal::MemberEntry const vec3Members [] = {
+     LUAPORTAL_FIELD(Vec3, x),
+     LUAPORTAL_PROPERTY(Vec3, "length", GetLength, SetLength),
+     LUAPORTAL_METHOD(Vec3, Dot),
+ };
+ @endcode
+
+ Overloaded member functions cannot be named this way; use
+ MemberFunctionThunk<Signature>::Entry<&Class::name>("name") directly.
+ */
+#define LUAPORTAL_METHOD(Class, name) \
+    luaportal::MemberFunctionThunk<decltype(&Class::name)>::template Entry<&Class::name>(#name)
+
+#define LUAPORTAL_FIELD(Class, name) \
+    luaportal::MemberDataThunk<decltype(&Class::name)>::template Entry<&Class::name>(#name)
+
+#define LUAPORTAL_PROPERTY(Class, name, get, set) \
+    luaportal::MemberEntry(name, luaportal::MemberEntry::Property, \
+        &luaportal::MemberGetterThunk<decltype(&Class::get)>::template Get<&Class::get>, \
+        &luaportal::MemberSetterThunk<decltype(&Class::set)>::template Set<&Class::set>)
+
+#define LUAPORTAL_READONLY_PROPERTY(Class, name, get) \
+    luaportal::MemberEntry(name, luaportal::MemberEntry::Property, \
+        &luaportal::MemberGetterThunk<decltype(&Class::get)>::template Get<&Class::get>, nullptr)
@@ -1,3 +1,45 @@
+//==============================================================================
+/**
+ Expected member counts of a class, enum or namespace registration.
+
+ Passing the counts to BeginClass(), DeriveClass(), BeginEnum() or
+ BeginNamespace() creates the registration tables with lua_createtable at
+ their final size, instead of growing them one rehash at a time while members
+ are added. The counts are only hints: registering more members still works,
+ and they are ignored when reopening an existing registration.
+
+ For a namespace, functions counts functions, classes, enums and nested
+ namespaces, and properties counts variables and properties. For an enum,
+ properties counts the values.
+ */
+struct MemberCount
+{
+    MemberCount()
+    : functions(0)
+    , properties(0)
+    , staticFunctions(0)
+    , staticProperties(0)
+    {
+    }
+    
+    explicit MemberCount(int functions_, int properties_ = 0, int staticFunctions_ = 0, int staticProperties_ = 0)
+    : functions(functions_)
+    , properties(properties_)
+    , staticFunctions(staticFunctions_)
+    , staticProperties(staticProperties_)
+    {
+    }
+    
+    /** Member functions and lambdas. */
+    int functions;
+    /** Data members and properties. */
+    int properties;
+    /** Static functions and lambdas. */
+    int staticFunctions;
+    /** Static data members and properties. */
+    int staticProperties;
+};
+
 //==============================================================================
 
 /** Provides C++ to Lua registration capabilities.
@@ -51,6 +93,12 @@ private:
         // the size of the stack will pop when registed Class(3) or Enum(1) finished
         int mutable metaSize;
         
+        // build flattened index tables when the registration ends
+        bool m_sealed;
+        
+        // register data members and properties as direct accessors
+        bool m_directAccessors;
+        
     protected:
         //--------------------------------------------------------------------------
         /**
@@ -89,7 +137,7 @@ private:
                     throw std::logic_error("not a cfunction");
                 }
                 
-                rawgetfield(L, -1, "__propget");           // Get __propget table
+                rawgetkey(L, -1, PropGetKey);           // Get __propget table
                 if(lua_istable(L, -1))                    // ensure it is a table
                 {
                     lua_pushvalue(L, 2);                     // push key arg2
@@ -103,6 +151,12 @@ private:
                         result = 1;
                         break;
                     }
+                    else if(isfulluserdata(L, -1))            // direct accessor
+                    {
+                        lua_remove(L, -2);                     // remove metatable
+                        result = CFunc::CallAccessor(L, -1);
+                        break;
+                    }
                     else if(lua_isnil(L, -1))
                     {
                         lua_pop(L, 1);
@@ -111,7 +165,7 @@ private:
                     {
                         lua_pop(L, 2);
                         
-                        // We only put cfunctions into __propget.
+                        // We only put cfunctions and accessors into __propget.
                         throw std::logic_error("not a cfunction");
                     }
                 }
@@ -125,7 +179,7 @@ private:
                 
                 // Repeat the lookup in the __parent metafield,
                 // or return nil if the field doesn't exist.
-                rawgetfield(L, -1, "__parent");
+                rawgetkey(L, -1, ParentKey);
                 if(lua_istable(L, -1))
                 {
                     // Remove metatable and repeat the search in __parent.
@@ -133,6 +187,12 @@ private:
                 }
                 else if(lua_isnil(L, -1))
                 {
+                    // Not a member, try the extension table of the object.
+                    if(Userdata::PushExtension(L, 1, false))
+                    {
+                        lua_pushvalue(L, 2);
+                        lua_rawget(L, -2);
+                    }
                     result = 1;
                     break;
                 }
@@ -147,6 +207,378 @@ private:
             return result;
         }
         
+        //--------------------------------------------------------------------------
+        /**
+         __index metamethod for a sealed class.
+         
+         The upvalue is the flattened index table built by SealTable(). Member
+         functions and direct accessors are stored in it as they are, property
+         getter closures are wrapped in a one element table. Keys which are not
+         in the table fall back to the regular lookup through the hierarchy.
+         */
+        static int SealedIndexMetaMethod(lua_State* L)
+        {
+            assert(lua_isuserdata(L, 1));               // warn on security bypass
+            lua_pushvalue(L, 2);
+            lua_rawget(L, lua_upvalueindex(1));
+            if(lua_iscfunction(L, -1))
+            {
+                return 1;
+            }
+            else if(lua_istable(L, -1))
+            {
+                lua_rawgeti(L, -1, 1);                   // property getter
+                lua_pushvalue(L, 1);
+                lua_call(L, 1, 1);
+                return 1;
+            }
+            else if(isfulluserdata(L, -1))
+            {
+                return CFunc::CallAccessor(L, -1);      // direct accessor
+            }
+            lua_pop(L, 1);
+            return IndexMetaMethod(L);
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         Copy the cfunctions with string keys of the table at `source` into the
+         table at `flat`, unless the key is already present. Both indices must
+         be absolute.
+         */
+        void FlattenInto(int flat, int source, bool isGetter) const
+        {
+            lua_pushnil(L);
+            while(lua_next(L, source) != 0)
+            {
+                if(lua_type(L, -2) == LUA_TSTRING && (lua_iscfunction(L, -1) || (isGetter && isfulluserdata(L, -1))))
+                {
+                    lua_pushvalue(L, -2);
+                    lua_rawget(L, flat);
+                    bool const isPresent = !lua_isnil(L, -1);
+                    lua_pop(L, 1);
+                    if(!isPresent)
+                    {
+                        lua_pushvalue(L, -2);
+                        if(isGetter && lua_iscfunction(L, -2))
+                        {
+                            lua_createtable(L, 1, 0);
+                            lua_pushvalue(L, -3);
+                            lua_rawseti(L, -2, 1);
+                        }
+                        else
+                        {
+                            lua_pushvalue(L, -2);
+                        }
+                        lua_rawset(L, flat);
+                    }
+                }
+                lua_pop(L, 1);
+            }
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         Count the entries SealTable() may collect for the table at `index`, so
+         that the flattened table is created at its final size.
+         */
+        int CountMembers(int index) const
+        {
+            int count = 0;
+            lua_pushvalue(L, index);
+            while(lua_istable(L, -1))
+            {
+                int const level = lua_gettop(L);
+                rawgetkey(L, level, PropGetKey);
+                for(int t = level; t <= level + 1; ++t)
+                {
+                    if(!lua_istable(L, t))
+                        continue;
+                    lua_pushnil(L);
+                    while(lua_next(L, t) != 0)
+                    {
+                        if(lua_type(L, -2) == LUA_TSTRING && (lua_iscfunction(L, -1) || isfulluserdata(L, -1)))
+                            ++count;
+                        lua_pop(L, 1);
+                    }
+                }
+                lua_pop(L, 1);
+                
+                rawgetkey(L, level, ParentKey);
+                lua_remove(L, level);
+            }
+            lua_pop(L, 1);
+            return count;
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         Mark the const and class tables of the class being registered as
+         those of an extensible class. The flag lives in the tables, so it
+         only applies to this lua_State.
+         */
+        void MarkExtensible() const
+        {
+            lua_pushboolean(L, 1);
+            rawsetkey(L, -4, ExtensibleKey);
+            lua_pushboolean(L, 1);
+            rawsetkey(L, -3, ExtensibleKey);
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         Give the class or const table at `index` a weak valued table under
+         CacheKey, which makes UserdataPtr reuse the userdata of a pointer.
+         */
+        void CreatePointerCache(int index) const
+        {
+            index = lua_absindex(L, index);
+            rawgetkey(L, index, CacheKey);
+            bool const hasCache = lua_istable(L, -1);
+            lua_pop(L, 1);
+            if(hasCache)
+                return;
+            
+            lua_newtable(L);
+            lua_createtable(L, 0, 1);
+            lua_pushstring(L, "v");
+            lua_setfield(L, -2, "__mode");
+            lua_setmetatable(L, -2);
+            rawsetkey(L, index, CacheKey);
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         Seal the class or const table at `index`.
+         
+         All member functions and property getters reachable from the table,
+         including those inherited through __parent, are collected into one
+         table which becomes the upvalue of SealedIndexMetaMethod. The lookup
+         order matches IndexMetaMethod: the nearest class wins, and within a
+         class a member function hides a property of the same name.
+         */
+        void SealTable(int index) const
+        {
+            index = lua_absindex(L, index);
+            lua_createtable(L, 0, CountMembers(index));
+            int const flat = lua_gettop(L);
+            
+            lua_pushvalue(L, index);
+            while(lua_istable(L, -1))
+            {
+                int const level = lua_gettop(L);
+                FlattenInto(flat, level, false);
+                
+                rawgetkey(L, level, PropGetKey);
+                if(lua_istable(L, -1))
+                {
+                    FlattenInto(flat, level + 1, true);
+                }
+                lua_pop(L, 1);
+                
+                rawgetkey(L, level, ParentKey);
+                lua_remove(L, level);
+            }
+            lua_pop(L, 1);
+            
+            lua_pushcclosure(L, &SealedIndexMetaMethod, 1);
+            
+            // A member dispatch stays in front, the sealed lookup handles the
+            // keys it does not know.
+            rawgetfield(L, index, "__index");
+            if(lua_tocfunction(L, -1) == &MemberIndexMetaMethod)
+            {
+                lua_insert(L, -2);
+                lua_setupvalue(L, -2, 2);
+                lua_pop(L, 1);
+            }
+            else
+            {
+                lua_pop(L, 1);
+                rawsetfield(L, index, "__index");
+            }
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         __index metamethod for a class with a compile time member list.
+         
+         The first upvalue is the MemberDispatch built by AddMembers(), the
+         second the __index metamethod it replaced, which handles the keys that
+         are not in the list.
+         */
+        static int MemberIndexMetaMethod(lua_State* L)
+        {
+            if(lua_type(L, 2) == LUA_TSTRING)
+            {
+                size_t length;
+                char const* const key = lua_tolstring(L, 2, &length);
+                MemberDispatch const* const dispatch =
+                    static_cast<MemberDispatch const*>(lua_touserdata(L, lua_upvalueindex(1)));
+                MemberEntry const* const entry = dispatch->Find(key, length);
+                if(entry != nullptr)
+                {
+                    if(entry->kind == MemberEntry::Property)
+                        return entry->get(L);
+                    lua_pushcfunction(L, entry->get);
+                    return 1;
+                }
+            }
+            
+            if(lua_tocfunction(L, lua_upvalueindex(2)) == &IndexMetaMethod)
+                return IndexMetaMethod(L);
+            lua_pushvalue(L, lua_upvalueindex(2));
+            lua_insert(L, 1);
+            lua_call(L, 2, 1);
+            return 1;
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         __newindex metamethod for a class with a compile time member list.
+         
+         The upvalues are the MemberDispatch and the replaced __newindex.
+         */
+        static int MemberNewIndexMetaMethod(lua_State* L)
+        {
+            if(lua_type(L, 2) == LUA_TSTRING)
+            {
+                size_t length;
+                char const* const key = lua_tolstring(L, 2, &length);
+                MemberDispatch const* const dispatch =
+                    static_cast<MemberDispatch const*>(lua_touserdata(L, lua_upvalueindex(1)));
+                MemberEntry const* const entry = dispatch->Find(key, length);
+                if(entry != nullptr && entry->kind == MemberEntry::Property)
+                {
+                    if(entry->set == nullptr)
+                        return luaL_error(L, "'%s' is read-only", key);
+                    lua_remove(L, 2);
+                    return entry->set(L);
+                }
+            }
+            
+            if(lua_tocfunction(L, lua_upvalueindex(2)) == &NewIndexMetaMethod)
+                return NewIndexMetaMethod(L);
+            lua_pushvalue(L, lua_upvalueindex(2));
+            lua_insert(L, 1);
+            lua_call(L, 3, 0);
+            return 0;
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         Put a MemberDispatch for the members in front of the __index(and for the
+         class table __newindex) of the table at `index`.
+         
+         Calling it again merges the members into the existing dispatch. The
+         const table only gets the const member functions and the getters.
+         */
+        void AddMemberDispatch(int index, MemberEntry const* members, size_t count, bool isConst) const
+        {
+            index = lua_absindex(L, index);
+            std::vector<MemberEntry> entries;
+            
+            rawgetfield(L, index, "__index");
+            if(lua_tocfunction(L, -1) == &MemberIndexMetaMethod)
+            {
+                lua_getupvalue(L, -1, 1);
+                static_cast<MemberDispatch const*>(lua_touserdata(L, -1))->GetEntries(entries);
+                lua_pop(L, 1);
+                lua_getupvalue(L, -1, 2);
+                lua_remove(L, -2);
+            }
+            
+            for(size_t i = 0; i< count; ++i)
+            {
+                if(isConst && members [i].kind == MemberEntry::Function)
+                    continue;
+                entries.push_back(members [i]);
+                if(isConst)
+                    entries.back().set = nullptr;
+            }
+            
+            MemberDispatch::Push(L, entries);
+            lua_insert(L, -2);
+            lua_pushvalue(L, -2);
+            lua_insert(L, -2);
+            lua_pushcclosure(L, &MemberIndexMetaMethod, 2);
+            rawsetfield(L, index, "__index");
+            
+            if(isConst)
+            {
+                lua_pop(L, 1);
+                return;
+            }
+            
+            rawgetfield(L, index, "__newindex");
+            if(lua_tocfunction(L, -1) == &MemberNewIndexMetaMethod)
+            {
+                lua_getupvalue(L, -1, 2);
+                lua_remove(L, -2);
+            }
+            lua_pushcclosure(L, &MemberNewIndexMetaMethod, 2);
+            rawsetfield(L, index, "__newindex");
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         Drop `name` from the MemberDispatch of the table at `index`, if it has
+         one, by rebuilding the dispatch without the entry.
+         
+         The dispatch is consulted before the class tables, so a member added or
+         replaced later through the Add* calls must not stay in it.
+         */
+        void RemoveFromMemberDispatch(int index, char const* name) const
+        {
+            index = lua_absindex(L, index);
+            rawgetfield(L, index, "__index");
+            if(lua_tocfunction(L, -1) != &MemberIndexMetaMethod)
+            {
+                lua_pop(L, 1);
+                return;
+            }
+            
+            size_t const length = strlen(name);
+            lua_getupvalue(L, -1, 1);
+            MemberDispatch const* const dispatch = static_cast<MemberDispatch const*>(lua_touserdata(L, -1));
+            if(dispatch->Find(name, length) == nullptr)
+            {
+                lua_pop(L, 2);
+                return;
+            }
+            
+            std::vector<MemberEntry> entries;
+            dispatch->GetEntries(entries);
+            lua_pop(L, 1);
+            for(size_t i = entries.size(); i > 0; --i)
+            {
+                if(entries [i - 1].length == length && memcmp(entries [i - 1].name, name, length) == 0)
+                    entries.erase(entries.begin() + (i - 1));
+            }
+            
+            // The __index and __newindex closures share the dispatch.
+            MemberDispatch::Push(L, entries);
+            lua_pushvalue(L, -1);
+            lua_setupvalue(L, -3, 1);
+            rawgetfield(L, index, "__newindex");
+            if(lua_tocfunction(L, -1) == &MemberNewIndexMetaMethod)
+            {
+                lua_pushvalue(L, -2);
+                lua_setupvalue(L, -2, 1);
+            }
+            lua_pop(L, 3);
+        }
+        
+        /**
+         Drop `name` from the member dispatch of the const and class tables of
+         the class being registered.
+         */
+        void RemoveFromMemberDispatch(char const* name) const
+        {
+            RemoveFromMemberDispatch(-3, name);
+            RemoveFromMemberDispatch(-2, name);
+        }
+        
         //--------------------------------------------------------------------------
         /**
          __newindex metamethod for classes.
@@ -163,12 +595,18 @@ private:
             for(;;)
             {
                 // Check __propset
-                rawgetfield(L, -1, "__propset");
+                rawgetkey(L, -1, PropSetKey);
                 if(!lua_isnil(L, -1))
                 {
                     lua_pushvalue(L, 2);
                     lua_rawget(L, -2);
-                    if(!lua_isnil(L, -1))
+                    if(isfulluserdata(L, -1))
+                    {
+                        // found a direct accessor, it reads the value at 3.
+                        result = CFunc::CallAccessor(L, -1);
+                        break;
+                    }
+                    else if(!lua_isnil(L, -1))
                     {
                         // found it, call the setFunction.
                         assert(lua_isfunction(L, -1));
@@ -183,9 +621,20 @@ private:
                 lua_pop(L, 1);
                 
                 // Repeat the lookup in the __parent metafield.
-                rawgetfield(L, -1, "__parent");
+                rawgetkey(L, -1, ParentKey);
                 if(lua_isnil(L, -1))
                 {
+                    // Extensible objects keep unknown fields in their
+                    // extension table.
+                    if(Userdata::PushExtension(L, 1, true))
+                    {
+                        lua_pushvalue(L, 2);
+                        lua_pushvalue(L, 3);
+                        lua_rawset(L, -3);
+                        result = 0;
+                        break;
+                    }
+                    
                     // Either the property or __parent must exist.
                     result = luaL_error(L,
                                          "no member named '%s'", lua_tostring(L, 2));
@@ -200,21 +649,23 @@ private:
         /**
          Create the const table.
          */
-        void CreateConstTable(char const* name)
+        void CreateConstTable(char const* name, MemberCount const& count)
         {
-            lua_newtable(L);
+            // identity key, __type, __index, __newindex, __propget, __metatable,
+            // __gc, __class and __parent, plus the const member functions.
+            lua_createtable(L, 0, 9 + count.functions);
             lua_pushvalue(L, -1);
             lua_setmetatable(L, -2);
             lua_pushboolean(L, 1);
             lua_rawsetp(L, -2, GetIdentityKey());
             lua_pushstring(L,(std::string("const ") + name).c_str());
-            rawsetfield(L, -2, "__type");
+            rawsetkey(L, -2, TypeKey);
             lua_pushcfunction(L, &IndexMetaMethod);
             rawsetfield(L, -2, "__index");
             lua_pushcfunction(L, &NewIndexMetaMethod);
             rawsetfield(L, -2, "__newindex");
-            lua_newtable(L);
-            rawsetfield(L, -2, "__propget");
+            lua_createtable(L, 0, count.properties);
+            rawsetkey(L, -2, PropGetKey);
             
             if(Security::HideMetatables())
             {
@@ -229,29 +680,31 @@ private:
          
          The Lua stack should have the const table on top.
          */
-        void CreateClassTable(char const* name)
+        void CreateClassTable(char const* name, MemberCount const& count)
         {
-            lua_newtable(L);
+            // identity key, __type, __index, __newindex, __propget, __propset,
+            // __const, __metatable, __gc and __parent, plus the member functions.
+            lua_createtable(L, 0, 10 + count.functions);
             lua_pushvalue(L, -1);
             lua_setmetatable(L, -2);
             lua_pushboolean(L, 1);
             lua_rawsetp(L, -2, GetIdentityKey());
             lua_pushstring(L, name);
-            rawsetfield(L, -2, "__type");
+            rawsetkey(L, -2, TypeKey);
             lua_pushcfunction(L, &IndexMetaMethod);
             rawsetfield(L, -2, "__index");
             lua_pushcfunction(L, &NewIndexMetaMethod);
             rawsetfield(L, -2, "__newindex");
-            lua_newtable(L);
-            rawsetfield(L, -2, "__propget");
-            lua_newtable(L);
-            rawsetfield(L, -2, "__propset");
+            lua_createtable(L, 0, count.properties);
+            rawsetkey(L, -2, PropGetKey);
+            lua_createtable(L, 0, count.properties);
+            rawsetkey(L, -2, PropSetKey);
             
             lua_pushvalue(L, -2);
-            rawsetfield(L, -2, "__const"); // point to const table
+            rawsetkey(L, -2, ConstKey); // point to const table
             
             lua_pushvalue(L, -1);
-            rawsetfield(L, -3, "__class"); // point const table to class table
+            rawsetkey(L, -3, ClassKey); // point const table to class table
             
             if(Security::HideMetatables())
             {
@@ -269,10 +722,12 @@ private:
          -2 const table
          -3 enclosing namespace
          */
-        void CreateStaticTable(char const* name)
+        void CreateStaticTable(char const* name, MemberCount const& count)
         {
             lua_newtable(L);
-            lua_newtable(L);
+            // __index, __newindex, __propget, __propset, __class, __metatable,
+            // __call and __parent, plus the static functions.
+            lua_createtable(L, 0, 8 + count.staticFunctions);
             lua_pushvalue(L, -1);
             lua_setmetatable(L, -3);
             lua_insert(L, -2);
@@ -287,13 +742,13 @@ private:
             rawsetfield(L, -2, "__index");
             lua_pushcfunction(L, &CFunc::NewIndexMetaMethod);
             rawsetfield(L, -2, "__newindex");
-            lua_newtable(L);
-            rawsetfield(L, -2, "__propget");
-            lua_newtable(L);
-            rawsetfield(L, -2, "__propset");
+            lua_createtable(L, 0, count.staticProperties);
+            rawsetkey(L, -2, PropGetKey);
+            lua_createtable(L, 0, count.staticProperties);
+            rawsetkey(L, -2, PropSetKey);
             
             lua_pushvalue(L, -2);
-            rawsetfield(L, -2, "__class"); // point to class table
+            rawsetkey(L, -2, ClassKey); // point to class table
             
             if(Security::HideMetatables())
             {
@@ -351,6 +806,8 @@ private:
         : L(L_)
         , m_stackSize(0)
         , metaSize(metaSize)
+        , m_sealed(false)
+        , m_directAccessors(false)
         {
         }
         
@@ -362,6 +819,8 @@ private:
         : L(other.L)
         , m_stackSize(0)
         , metaSize(0)
+        , m_sealed(other.m_sealed)
+        , m_directAccessors(other.m_directAccessors)
         {
             m_stackSize = other.m_stackSize;
             other.m_stackSize = 0;
@@ -396,7 +855,7 @@ private:
         /**
          Register a new class or add to an existing class registration.
          */
-        Class(char const* name, Namespace const* parent) 
+        Class(char const* name, Namespace const* parent, MemberCount const& count = MemberCount()) 
         : ClassBase(parent->L, 3)
         {
             m_stackSize = parent->m_stackSize + metaSize;
@@ -408,15 +867,17 @@ private:
             {
                 lua_pop(L, 1);
                 
-                CreateConstTable(name);
+                CreateConstTable(name, count);
                 lua_pushcfunction(L, &CFunc::GCMetaMethod<T>);
                 rawsetfield(L, -2, "__gc");
                 
-                CreateClassTable(name);
+                CreateClassTable(name, count);
                 lua_pushcfunction(L, &CFunc::GCMetaMethod<T>);
                 rawsetfield(L, -2, "__gc");
                 
-                CreateStaticTable(name);
+                CreateStaticTable(name, count);
+                
+                ClassInfo<T>::RegisterRoot();
                 
                 // Map T back to its tables.
                 lua_pushvalue(L, -1);
@@ -428,8 +889,8 @@ private:
             }
             else
             {
-                rawgetfield(L, -1, "__class");
-                rawgetfield(L, -1, "__const");
+                rawgetkey(L, -1, ClassKey);
+                rawgetkey(L, -1, ConstKey);
                 
                 // Reverse the top 3 stack elements
                 lua_insert(L, -3);
@@ -442,7 +903,8 @@ private:
         /**
          Derive a new class.
          */
-        Class(char const* name, Namespace const* parent, void const* const staticKey)
+        Class(char const* name, Namespace const* parent, void const* const staticKey,
+              ClassRecord const& parentRecord, MemberCount const& count = MemberCount())
         : ClassBase(parent->L, 3)
         {
             m_stackSize = parent->m_stackSize + metaSize;
@@ -450,26 +912,36 @@ private:
             
             assert(lua_istable(L, -1));
             
-            CreateConstTable(name);
+            CreateConstTable(name, count);
             lua_pushcfunction(L, &CFunc::GCMetaMethod<T>);
             rawsetfield(L, -2, "__gc");
             
-            CreateClassTable(name);
+            CreateClassTable(name, count);
             lua_pushcfunction(L, &CFunc::GCMetaMethod<T>);
             rawsetfield(L, -2, "__gc");
             
-            CreateStaticTable(name);
+            CreateStaticTable(name, count);
             
             lua_rawgetp(L, LUA_REGISTRYINDEX, staticKey);
             assert(lua_istable(L, -1));
-            rawgetfield(L, -1, "__class");
+            rawgetkey(L, -1, ClassKey);
             assert(lua_istable(L, -1));
-            rawgetfield(L, -1, "__const");
+            rawgetkey(L, -1, ConstKey);
             assert(lua_istable(L, -1));
             
-            rawsetfield(L, -6, "__parent");
-            rawsetfield(L, -4, "__parent");
-            rawsetfield(L, -2, "__parent");
+            rawsetkey(L, -6, ParentKey);
+            rawsetkey(L, -4, ParentKey);
+            rawsetkey(L, -2, ParentKey);
+            
+            // Classes derived from an extensible class are extensible.
+            rawgetkey(L, -2, ParentKey);
+            rawgetkey(L, -1, ExtensibleKey);
+            bool const isExtensible = lua_toboolean(L, -1) != 0;
+            lua_pop(L, 2);
+            if(isExtensible)
+                MarkExtensible();
+            
+            ClassInfo<T>::RegisterDerived(parentRecord);
             
             lua_pushvalue(L, -1);
             lua_rawsetp(L, LUA_REGISTRYINDEX, ClassInfo<T>::GetStaticKey());
@@ -479,12 +951,154 @@ private:
             lua_rawsetp(L, LUA_REGISTRYINDEX, ClassInfo<T>::GetConstKey());
         }
         
+        //--------------------------------------------------------------------------
+        /**
+         Seal the class when the registration ends.
+         
+         A sealed class resolves members through a single flattened table that
+         holds its own and all inherited member functions and property getters,
+         so a lookup costs one rawget regardless of the inheritance depth.
+         
+         The table is a snapshot taken at EndClass(). Members added to a base
+         class afterwards are still found, but replacements are not seen; call
+         Seal() again when reopening the class with BeginClass().
+         */
+        Class<T>& Seal()
+        {
+            m_sealed = true;
+            return *this;
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         Let scripts add their own fields to objects of the class.
+         
+         Fields which are not members are stored in a table held in the user
+         value of the object(a registry side table on Lua 5.1), created on the
+         first assignment, and collected with the object. Members always take
+         precedence. Objects pushed before this call have no user value on Lua
+         5.4 and stay closed. Derived classes registered afterwards are
+         extensible as well.
+         
+         The setting belongs to the class tables of this lua_State, other
+         states are not affected.
+         */
+        Class<T>& Extensible()
+        {
+            MarkExtensible();
+            return *this;
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         Push each pointer to an object of the class as a single userdata.
+         
+         Pushing the same T* again, for example returning a singleton from a
+         getter, reuses the userdata as long as Lua keeps it alive, so scripts
+         can compare the objects with == and no garbage is created. Call
+         UserdataPtr::Invalidate() when such an object is destroyed. Objects
+         pushed by value or through a container are not affected.
+         
+         The cache lives in the class and const tables, so the setting only
+         applies to this lua_State and is not inherited by derived classes.
+         */
+        Class<T>& CachePointers()
+        {
+            CreatePointerCache(-3);
+            CreatePointerCache(-2);
+            return *this;
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         Register the following data members and member function properties as
+         direct accessors.
+         
+         A direct accessor is called by the index metamethods themselves instead
+         of through a nested lua_call of a getter or setter closure, which
+         removes a Lua call frame from every `obj.x` read and `obj.x = v`
+         write. Combined with Seal(), a read is a single lookup in the
+         flattened table followed by the accessor. Properties implemented by
+         proxy functions are still registered as closures.
+         */
+        Class<T>& UseDirectAccessors()
+        {
+            m_directAccessors = true;
+            return *this;
+        }
+        
+        //--------------------------------------------------------------------------
+        /**
+         Add the members of a compile time member list.
+         
+         The members are registered like AddFunction(), AddData() and
+         AddProperty() would, so derived classes, Seal() and the regular
+         lookup see them, and are also put into a perfect hash table consulted
+         by the object __index and __newindex before anything else. A hit calls
+         the typed thunk of the member right away; other keys, including
+         members added with the regular functions, go through the usual
+         lookup.
+         
+         e.g. @code
+         static MemberEntry const members [] = {
+             LUAPORTAL_FIELD(Vec3, x),
+             LUAPORTAL_METHOD(Vec3, Dot),
+         };
+         ns.BeginClass<Vec3>("Vec3").AddMembers(members).EndClass();
+         @endcode
+         */
+        template<size_t N>
+        Class<T>& AddMembers(MemberEntry const(&members) [N])
+        {
+            for(size_t i = 0; i< N; ++i)
+            {
+                MemberEntry const& member = members [i];
+                if(member.kind == MemberEntry::Property)
+                {
+                    rawgetkey(L, -2, PropGetKey);
+                    rawgetkey(L, -4, PropGetKey);
+                    lua_pushcfunction(L, member.get);
+                    lua_pushvalue(L, -1);
+                    rawsetfield(L, -4, member.name);
+                    rawsetfield(L, -2, member.name);
+                    lua_pop(L, 2);
+                    
+                    if(member.set != nullptr)
+                    {
+                        rawgetkey(L, -2, PropSetKey);
+                        lua_pushcfunction(L, member.set);
+                        rawsetfield(L, -2, member.name);
+                        lua_pop(L, 1);
+                    }
+                }
+                else
+                {
+                    lua_pushcfunction(L, member.get);
+                    if(member.kind == MemberEntry::ConstFunction)
+                    {
+                        lua_pushvalue(L, -1);
+                        rawsetfield(L, -5, member.name); // const table
+                    }
+                    rawsetfield(L, -3, member.name); // class table
+                }
+            }
+            
+            AddMemberDispatch(-2, members, N, false);
+            AddMemberDispatch(-3, members, N, true);
+            return *this;
+        }
+        
         //--------------------------------------------------------------------------
         /**
          Continue registration in the enclosing namespace.
          */
         Namespace EndClass()
         {
+            if(m_sealed)
+            {
+                SealTable(-2);
+                SealTable(-3);
+            }
             return Namespace(this);
         }
         
@@ -497,14 +1111,14 @@ private:
         {
             assert(lua_istable(L, -1));
             
-            rawgetfield(L, -1, "__propget");
+            rawgetkey(L, -1, PropGetKey);
             assert(lua_istable(L, -1));
             lua_pushlightuserdata(L, pu);
             lua_pushcclosure(L, &CFunc::GetVariable<U>, 1);
             rawsetfield(L, -2, name);
             lua_pop(L, 1);
             
-            rawgetfield(L, -1, "__propset");
+            rawgetkey(L, -1, PropSetKey);
             assert(lua_istable(L, -1));
             if(isWritable)
             {
@@ -533,14 +1147,14 @@ private:
             
             U* pu = TypeTraits::GetPtr(u);
             
-            rawgetfield(L, -1, "__propget");
+            rawgetkey(L, -1, PropGetKey);
             assert(lua_istable(L, -1));
             lua_pushlightuserdata(L, pu);
             lua_pushcclosure(L, &CFunc::GetVariable<U>, 1);
             rawsetfield(L, -2, name);
             lua_pop(L, 1);
             
-            rawgetfield(L, -1, "__propset");
+            rawgetkey(L, -1, PropSetKey);
             assert(lua_istable(L, -1));
             if(isWritable)
             {
@@ -572,18 +1186,18 @@ private:
             
             assert(lua_istable(L, -1));
             
-            rawgetfield(L, -1, "__propget");
+            rawgetkey(L, -1, PropGetKey);
             assert(lua_istable(L, -1));
-            new(lua_newuserdata(L, sizeof(Get))) get_t(Get);
+            new(luaS_newuserdata(L, sizeof(Get), 0)) get_t(Get);
             lua_pushcclosure(L, &CFunc::Call<U(*)(void)>::GeneratedFunction, 1);
             rawsetfield(L, -2, name);
             lua_pop(L, 1);
             
-            rawgetfield(L, -1, "__propset");
+            rawgetkey(L, -1, PropSetKey);
             assert(lua_istable(L, -1));
             if(set != 0)
             {
-                new(lua_newuserdata(L, sizeof(set))) set_t(set);
+                new(luaS_newuserdata(L, sizeof(set), 0)) set_t(set);
                 lua_pushcclosure(L, &CFunc::Call<void(*)(U)>::GeneratedFunction, 1);
             }
             else
@@ -604,7 +1218,7 @@ private:
         template<typename FP>
         Class<T>& AddStaticFunction(char const* name, FP const fp)
         {
-            new(lua_newuserdata(L, sizeof(fp))) FP(fp);
+            new(luaS_newuserdata(L, sizeof(fp), 0)) FP(fp);
             lua_pushcclosure(L, &CFunc::Call<FP>::GeneratedFunction, 1);
             rawsetfield(L, -2, name);
             
@@ -629,13 +1243,36 @@ private:
         template<typename U>
         Class<T>& AddData(char const* name, const U T::* mp, bool isWritable = true)
         {
+            RemoveFromMemberDispatch(name);
             typedef const U T::*mp_t;
             
+            if(m_directAccessors)
+            {
+                typedef U T::*accessor_t;
+                
+                rawgetkey(L, -2, PropGetKey);
+                rawgetkey(L, -4, PropGetKey);
+                CFunc::PushAccessor(L, &CFunc::GetDataAccessor<T,U>, const_cast<accessor_t>(mp));
+                lua_pushvalue(L, -1);
+                rawsetfield(L, -4, name);
+                rawsetfield(L, -2, name);
+                lua_pop(L, 2);
+                
+                if(isWritable)
+                {
+                    rawgetkey(L, -2, PropSetKey);
+                    CFunc::PushAccessor(L, &CFunc::SetDataAccessor<T,U>, const_cast<accessor_t>(mp));
+                    rawsetfield(L, -2, name);
+                    lua_pop(L, 1);
+                }
+                return *this;
+            }
+            
             // Add to __propget in class and const tables.
             {
-                rawgetfield(L, -2, "__propget");
-                rawgetfield(L, -4, "__propget");
-                new(lua_newuserdata(L, sizeof(mp_t))) mp_t(mp);
+                rawgetkey(L, -2, PropGetKey);
+                rawgetkey(L, -4, PropGetKey);
+                new(luaS_newuserdata(L, sizeof(mp_t), 0)) mp_t(mp);
                 lua_pushcclosure(L, &CFunc::GetProperty<T,U>, 1);
                 lua_pushvalue(L, -1);
                 rawsetfield(L, -4, name);
@@ -646,9 +1283,9 @@ private:
             if(isWritable)
             {
                 // Add to __propset in class table.
-                rawgetfield(L, -2, "__propset");
+                rawgetkey(L, -2, PropSetKey);
                 assert(lua_istable(L, -1));
-                new(lua_newuserdata(L, sizeof(mp_t))) mp_t(mp);
+                new(luaS_newuserdata(L, sizeof(mp_t), 0)) mp_t(mp);
                 lua_pushcclosure(L, &CFunc::SetProperty<T,U>, 1);
                 rawsetfield(L, -2, name);
                 lua_pop(L, 1);
@@ -664,12 +1301,30 @@ private:
         template<typename TG, typename TS>
         Class<T>& AddProperty(char const* name, TG(T::* Get)() const, void(T::* set)(TS))
         {
+            RemoveFromMemberDispatch(name);
+            if(m_directAccessors)
+            {
+                rawgetkey(L, -2, PropGetKey);
+                rawgetkey(L, -4, PropGetKey);
+                CFunc::PushAccessor(L, &CFunc::GetPropertyAccessor<T,TG>, Get);
+                lua_pushvalue(L, -1);
+                rawsetfield(L, -4, name);
+                rawsetfield(L, -2, name);
+                lua_pop(L, 2);
+                
+                rawgetkey(L, -2, PropSetKey);
+                CFunc::PushAccessor(L, &CFunc::SetPropertyAccessor<T,TS>, set);
+                rawsetfield(L, -2, name);
+                lua_pop(L, 1);
+                return *this;
+            }
+            
             // Add to __propget in class and const tables.
             {
-                rawgetfield(L, -2, "__propget");
-                rawgetfield(L, -4, "__propget");
+                rawgetkey(L, -2, PropGetKey);
+                rawgetkey(L, -4, PropGetKey);
                 typedef TG(T::*get_t)() const;
-                new(lua_newuserdata(L, sizeof(get_t))) get_t(Get);
+                new(luaS_newuserdata(L, sizeof(get_t), 0)) get_t(Get);
                 lua_pushcclosure(L, &CFunc::CallConstMember<get_t>::GeneratedFunction, 1);
                 lua_pushvalue(L, -1);
                 rawsetfield(L, -4, name);
@@ -679,10 +1334,10 @@ private:
             
             {
                 // Add to __propset in class table.
-                rawgetfield(L, -2, "__propset");
+                rawgetkey(L, -2, PropSetKey);
                 assert(lua_istable(L, -1));
                 typedef void(T::* set_t)(TS);
-                new(lua_newuserdata(L, sizeof(set_t))) set_t(set);
+                new(luaS_newuserdata(L, sizeof(set_t), 0)) set_t(set);
                 lua_pushcclosure(L, &CFunc::CallMember<set_t>::GeneratedFunction, 1);
                 rawsetfield(L, -2, name);
                 lua_pop(L, 1);
@@ -695,18 +1350,26 @@ private:
         template<typename TG>
         Class<T>& AddProperty(char const* name, TG(T::* Get)() const)
         {
+            RemoveFromMemberDispatch(name);
             // Add to __propget in class and const tables.
-            rawgetfield(L, -2, "__propget");
-            rawgetfield(L, -4, "__propget");
-            typedef TG(T::*get_t)() const;
-            new(lua_newuserdata(L, sizeof(get_t))) get_t(Get);
-            lua_pushcclosure(L, &CFunc::CallConstMember<get_t>::GeneratedFunction, 1);
+            rawgetkey(L, -2, PropGetKey);
+            rawgetkey(L, -4, PropGetKey);
+            if(m_directAccessors)
+            {
+                CFunc::PushAccessor(L, &CFunc::GetPropertyAccessor<T,TG>, Get);
+            }
+            else
+            {
+                typedef TG(T::*get_t)() const;
+                new(luaS_newuserdata(L, sizeof(get_t), 0)) get_t(Get);
+                lua_pushcclosure(L, &CFunc::CallConstMember<get_t>::GeneratedFunction, 1);
+            }
             lua_pushvalue(L, -1);
             rawsetfield(L, -4, name);
             rawsetfield(L, -2, name);
             lua_pop(L, 2);
 
-            rawgetfield(L, -2, "__propset");
+            rawgetkey(L, -2, PropSetKey);
             lua_pushstring(L, name);
             lua_pushcclosure(L, &CFunc::ReadOnlyError, 1);
             rawsetfield(L, -2, name);
@@ -729,12 +1392,13 @@ private:
         template<typename TG, typename TS>
         Class<T>& AddProperty(char const* name, TG(*Get)(T const*), void(*set)(T*, TS))
         {
+            RemoveFromMemberDispatch(name);
             // Add to __propget in class and const tables.
             {
-                rawgetfield(L, -2, "__propget");
-                rawgetfield(L, -4, "__propget");
+                rawgetkey(L, -2, PropGetKey);
+                rawgetkey(L, -4, PropGetKey);
                 typedef TG(*get_t)(T const*);
-                new(lua_newuserdata(L, sizeof(get_t))) get_t(Get);
+                new(luaS_newuserdata(L, sizeof(get_t), 0)) get_t(Get);
                 lua_pushcclosure(L, &CFunc::Call<get_t>::GeneratedFunction, 1);
                 lua_pushvalue(L, -1);
                 rawsetfield(L, -4, name);
@@ -745,10 +1409,10 @@ private:
             if(set != 0)
             {
                 // Add to __propset in class table.
-                rawgetfield(L, -2, "__propset");
+                rawgetkey(L, -2, PropSetKey);
                 assert(lua_istable(L, -1));
                 typedef void(*set_t)(T*, TS);
-                new(lua_newuserdata(L, sizeof(set_t))) set_t(set);
+                new(luaS_newuserdata(L, sizeof(set_t), 0)) set_t(set);
                 lua_pushcclosure(L, &CFunc::Call<set_t>::GeneratedFunction, 1);
                 rawsetfield(L, -2, name);
                 lua_pop(L, 1);
@@ -761,11 +1425,12 @@ private:
         template<typename TG, typename TS>
         Class<T>& AddProperty(char const* name, TG(*Get)(T const*))
         {
+            RemoveFromMemberDispatch(name);
             // Add to __propget in class and const tables.
-            rawgetfield(L, -2, "__propget");
-            rawgetfield(L, -4, "__propget");
+            rawgetkey(L, -2, PropGetKey);
+            rawgetkey(L, -4, PropGetKey);
             typedef TG(*get_t)(T const*);
-            new(lua_newuserdata(L, sizeof(get_t))) get_t(Get);
+            new(luaS_newuserdata(L, sizeof(get_t), 0)) get_t(Get);
             lua_pushcclosure(L, &CFunc::Call<get_t>::GeneratedFunction, 1);
             lua_pushvalue(L, -1);
             rawsetfield(L, -4, name);
@@ -782,6 +1447,7 @@ private:
         template<typename MemFn>
         Class<T>& AddFunction(char const* name, MemFn mf)
         {
+            RemoveFromMemberDispatch(name);
             CFunc::CallMemberFunctionHelper<MemFn, FuncTraits<MemFn>::IsConstMemberFunction>::AddFunction(L, name, mf);
             return *this;
         }
@@ -793,11 +1459,11 @@ private:
         template<typename Callable>
         Class<T>& AddLambda(char const* name,const Callable& ml)
         {
+            RemoveFromMemberDispatch(name);
             assert(lua_istable(L, -1));
-            typedef typename callable_traits<Callable>::function_type FunctionType;
-            typedef std::function<FunctionType> LambdaType;
+            typedef typename std::decay<Callable>::type LambdaType;
             
-            new(lua_newuserdata(L, sizeof(LambdaType))) LambdaType(ml);
+            CallableUserdata<LambdaType>::Push(L, ml);
             lua_pushcclosure(L, &MemberLambda<T, LambdaType>::Call, 1);
             rawsetfield(L, -3, name); // class table
             return *this;
@@ -811,10 +1477,9 @@ private:
         Class<T>& AddStaticLambda(char const* name,const Callable& sl)
         {
             assert(lua_istable(L, -1));
-            typedef typename callable_traits<Callable>::function_type FunctionType;
-            typedef std::function<FunctionType> LambdaType;
+            typedef typename std::decay<Callable>::type LambdaType;
             
-            new(lua_newuserdata(L, sizeof(LambdaType))) LambdaType(sl);
+            CallableUserdata<LambdaType>::Push(L, sl);
             lua_pushcclosure(L, &StaticLambda<LambdaType>::Call, 1);
             rawsetfield(L, -2, name);
             return *this;
@@ -826,9 +1491,10 @@ private:
          */
         Class<T>& AddCFunction(char const* name, int(T::*mfp)(lua_State*))
         {
+            RemoveFromMemberDispatch(name);
             typedef int(T::*MFP)(lua_State*);
             assert(lua_istable(L, -1));
-            new(lua_newuserdata(L, sizeof(mfp))) MFP(mfp);
+            new(luaS_newuserdata(L, sizeof(mfp), 0)) MFP(mfp);
             lua_pushcclosure(L, &CFunc::CallMemberCFunction<T>::GeneratedFunction, 1);
             rawsetfield(L, -3, name); // class table
             
@@ -841,9 +1507,10 @@ private:
          */
         Class<T>& AddCFunction(char const* name, int(T::*mfp)(lua_State*) const)
         {
+            RemoveFromMemberDispatch(name);
             typedef int(T::*MFP)(lua_State*) const;
             assert(lua_istable(L, -1));
-            new(lua_newuserdata(L, sizeof(mfp))) MFP(mfp);
+            new(luaS_newuserdata(L, sizeof(mfp), 0)) MFP(mfp);
             lua_pushcclosure(L, &CFunc::CallConstMemberCFunction<T>::GeneratedFunction, 1);
             lua_pushvalue(L, -1);
             rawsetfield(L, -5, name); // const table
@@ -912,7 +1579,7 @@ private:
     class Enum : public ClassBase
     {
     public:
-        Enum(char const* name, Namespace const* parent)
+        Enum(char const* name, Namespace const* parent, MemberCount const& count = MemberCount())
         : ClassBase(parent->L, 1)
         {         
             m_stackSize = parent->m_stackSize + metaSize;
@@ -925,7 +1592,7 @@ private:
                 lua_pop(L, 1);
                 
                 lua_newtable(L);
-                lua_newtable(L);
+                lua_createtable(L, 0, 5);
                 lua_pushvalue(L, -1);
                 lua_setmetatable(L, -3);
                 lua_insert(L, -2);
@@ -934,10 +1601,10 @@ private:
                 rawsetfield(L, -2, "__index");
                 lua_pushcfunction(L, &CFunc::NewIndexMetaMethod);
                 rawsetfield(L, -2, "__newindex");
-                lua_newtable(L);
-                rawsetfield(L, -2, "__propget");
-                lua_newtable(L);
-                rawsetfield(L, -2, "__propset");
+                lua_createtable(L, 0, count.properties);
+                rawsetkey(L, -2, PropGetKey);
+                lua_createtable(L, 0, count.properties);
+                rawsetkey(L, -2, PropSetKey);
                 if(Security::HideMetatables())
                 {
                     lua_pushstring(L, "__metatable");
@@ -958,7 +1625,7 @@ private:
         {
             assert(lua_istable(L, -1));
             
-            rawgetfield(L, -1, "__propget");
+            rawgetkey(L, -1, PropGetKey);
             assert(lua_istable(L, -1));
             
             Stack<T>::Push(L, t);
@@ -966,7 +1633,7 @@ private:
             rawsetfield(L, -2, name);
             lua_pop(L, 1);
             
-            rawgetfield(L, -1, "__propset");
+            rawgetkey(L, -1, PropSetKey);
             assert(lua_istable(L, -1));
             lua_pushstring(L, name);
             lua_pushcclosure(L, &CFunc::ReadOnlyError, 1);
@@ -1006,7 +1673,7 @@ private:
      The namespace is created if it doesn't already exist.
      The parent namespace is at the top of the Lua stack.
      */
-    Namespace(char const* name, Namespace const* parent)
+    Namespace(char const* name, Namespace const* parent, MemberCount const& count = MemberCount())
     : L(parent->L)
     , m_stackSize(0)
     {
@@ -1019,17 +1686,18 @@ private:
         {
             lua_pop(L, 1);
             
-            lua_newtable(L);
+            // __index, __newindex, __propget and __propset, plus the members.
+            lua_createtable(L, 0, 4 + count.functions);
             lua_pushvalue(L, -1);
             lua_setmetatable(L, -2);
             lua_pushcfunction(L, &CFunc::IndexMetaMethod);
             rawsetfield(L, -2, "__index");
             lua_pushcfunction(L, &CFunc::NewIndexMetaMethod);
             rawsetfield(L, -2, "__newindex");
-            lua_newtable(L);
-            rawsetfield(L, -2, "__propget");
-            lua_newtable(L);
-            rawsetfield(L, -2, "__propset");
+            lua_createtable(L, 0, count.properties);
+            rawsetkey(L, -2, PropGetKey);
+            lua_createtable(L, 0, count.properties);
+            rawsetkey(L, -2, PropSetKey);
             lua_pushvalue(L, -1);
             rawsetfield(L, -3, name);
 #if 0
@@ -1107,9 +1775,9 @@ public:
     /**
      Open a new or existing namespace for registrations.
      */
-    Namespace BeginNamespace(char const* name)
+    Namespace BeginNamespace(char const* name, MemberCount const& count = MemberCount())
     {
-        return Namespace(name, this);
+        return Namespace(name, this, count);
     }
     
     //----------------------------------------------------------------------------
@@ -1132,14 +1800,14 @@ public:
     {
         assert(lua_istable(L, -1));
         
-        rawgetfield(L, -1, "__propget");
+        rawgetkey(L, -1, PropGetKey);
         assert(lua_istable(L, -1));
         lua_pushlightuserdata(L, pt);
         lua_pushcclosure(L, &CFunc::GetVariable<T>, 1);
         rawsetfield(L, -2, name);
         lua_pop(L, 1);
         
-        rawgetfield(L, -1, "__propset");
+        rawgetkey(L, -1, PropSetKey);
         assert(lua_istable(L, -1));
         if(isWritable)
         {
@@ -1168,20 +1836,20 @@ public:
     {
         assert(lua_istable(L, -1));
         
-        rawgetfield(L, -1, "__propget");
+        rawgetkey(L, -1, PropGetKey);
         assert(lua_istable(L, -1));
         typedef TG(*get_t)();
-        new(lua_newuserdata(L, sizeof(get_t))) get_t(Get);
+        new(luaS_newuserdata(L, sizeof(get_t), 0)) get_t(Get);
         lua_pushcclosure(L, &CFunc::Call<TG(*)(void)>::GeneratedFunction, 1);
         rawsetfield(L, -2, name);
         lua_pop(L, 1);
         
-        rawgetfield(L, -1, "__propset");
+        rawgetkey(L, -1, PropSetKey);
         assert(lua_istable(L, -1));
         if(set != 0)
         {
             typedef void(*set_t)(TS);
-            new(lua_newuserdata(L, sizeof(set_t))) set_t(set);
+            new(luaS_newuserdata(L, sizeof(set_t), 0)) set_t(set);
             lua_pushcclosure(L, &CFunc::Call<void(*)(TS)>::GeneratedFunction, 1);
         }
         else
@@ -1204,7 +1872,7 @@ public:
     {
         assert(lua_istable(L, -1));
         
-        new(lua_newuserdata(L, sizeof(fp))) FP(fp);
+        new(luaS_newuserdata(L, sizeof(fp), 0)) FP(fp);
         lua_pushcclosure(L, &CFunc::Call<FP>::GeneratedFunction, 1);
         rawsetfield(L, -2, name);
         
@@ -1216,10 +1884,9 @@ public:
     Namespace& AddLambda(char const* name,const Callable& sl)
     {
         assert(lua_istable(L, -1));
-        typedef typename callable_traits<Callable>::function_type FunctionType;
-        typedef std::function<FunctionType> LambdaType;
+        typedef typename std::decay<Callable>::type LambdaType;
         
-        new(lua_newuserdata(L, sizeof(LambdaType))) LambdaType(sl);
+        CallableUserdata<LambdaType>::Push(L, sl);
         lua_pushcclosure(L, &StaticLambda<LambdaType>::Call, 1);
         rawsetfield(L, -2, name);
         return *this;
@@ -1242,9 +1909,9 @@ public:
      Open a new or existing class for registrations.
      */
     template<typename T>
-    Class<T> BeginClass(char const* name)
+    Class<T> BeginClass(char const* name, MemberCount const& count = MemberCount())
     {
-        return Class<T>(name, this);
+        return Class<T>(name, this, count);
     }
     
     //----------------------------------------------------------------------------
@@ -1252,9 +1919,9 @@ public:
      Open a new or existing Enum for registrations.
      */
     template<typename T>
-    Enum<T> BeginEnum(char const* name)
+    Enum<T> BeginEnum(char const* name, MemberCount const& count = MemberCount())
     {
-        return Enum<T>(name, this);
+        return Enum<T>(name, this, count);
     }
     
     //----------------------------------------------------------------------------
@@ -1265,9 +1932,9 @@ public:
      Do not call deriveClass() again.
      */
     template<typename T, typename U>
-    Class<T> DeriveClass(char const* name)
+    Class<T> DeriveClass(char const* name, MemberCount const& count = MemberCount())
     {
-        return Class<T>(name, this, ClassInfo<U>::GetStaticKey());
+        return Class<T>(name, this, ClassInfo<U>::GetStaticKey(), ClassInfo<U>::GetRecord(), count);
     }
 };
 
@@ -0,0 +1,565 @@
+//==============================================================================
+/**
+ A recorded registration program that can be replayed into fresh states.
+
+ Capture() runs the registration code once, on a scratch state, and records
+ everything it added: the globals it defined and the registry entries keyed
+ by light userdata(the class, const and static metatables), together with the
+ graph of tables, metatables and C closures reachable from them. Apply()
+ rebuilds that graph in another state from the flat instruction list: tables
+ are created presized with lua_createtable, closures are pushed with their
+ recorded C function and upvalues, and no template code runs again.
+
+ The snapshot holds plain function and data pointers, so it is only valid in
+ the process that captured it. It can capture:
+
+ - tables, their metatables and any nesting or cycles between them
+ - C functions and closures with their upvalues
+ - full userdata without a metatable(the member and function pointers
+   stored as closure upvalues), copied bytewise
+ - strings, numbers, booleans and light userdata
+
+ Objects that already existed in a fresh state(e.g. library tables) are
+ referenced by their path from the globals or the registry; changes the
+ registration makes inside such tables are not recorded. Lua functions,
+ threads and userdata with a metatable(object instances, lambdas that are not
+ trivially destructible) cannot be replayed and make Capture() throw
+ std::logic_error.
+
+ e.g. @code
+ static RegistrationSnapshot const snapshot = RegistrationSnapshot::Capture(
+     [](lua_State* L) { GetGlobalNamespace(L).BeginClass<Foo>("Foo").EndClass(); });
+
+ LuaState ls;
+ snapshot.Apply(ls.GetState());
+ @endcode
+ */
+class RegistrationSnapshot
+{
+public:
+    typedef std::function<void(lua_State*)> Registration;
+
+    //--------------------------------------------------------------------------
+    /**
+     Run registration on a scratch state and record its effects.
+     */
+    static RegistrationSnapshot Capture(Registration const& registration)
+    {
+        RegistrationSnapshot snapshot;
+        lua_State* L = luaS_newstate();
+        try
+        {
+            Capturer(snapshot, L).Run(registration);
+        }
+        catch(...)
+        {
+            luaS_close(L);
+            throw;
+        }
+        luaS_close(L);
+        return snapshot;
+    }
+
+    //--------------------------------------------------------------------------
+    /**
+     Replay the recorded registration into L.
+     */
+    void Apply(lua_State* L) const
+    {
+        int const top = lua_gettop(L);
+        lua_createtable(L, static_cast<int>(m_objects.size()), 0);
+        int const store = lua_gettop(L);
+
+        // Tables and userdata first, closures may refer to them.
+        for(size_t i = 0; i< m_objects.size(); ++i)
+        {
+            Object const& object = m_objects [i];
+            if(object.kind == Object::Table)
+            {
+                lua_createtable(L, object.narr, object.nrec);
+            }
+            else if(object.kind == Object::Userdata)
+            {
+                void* p = luaS_newuserdata(L, object.bytes.size(), 0);
+                memcpy(p, object.bytes.data(), object.bytes.size());
+            }
+            else
+            {
+                continue;
+            }
+            lua_rawseti(L, store, static_cast<int>(i + 1));
+        }
+
+        // Closures are recorded after the closures among their upvalues.
+        for(size_t i = 0; i< m_objects.size(); ++i)
+        {
+            Object const& object = m_objects [i];
+            if(object.kind != Object::Function)
+                continue;
+
+            for(size_t u = 0; u< object.upvalues.size(); ++u)
+            {
+                Push(L, store, object.upvalues [u]);
+            }
+            lua_pushcclosure(L, object.function, static_cast<int>(object.upvalues.size()));
+            lua_rawseti(L, store, static_cast<int>(i + 1));
+        }
+
+        for(size_t i = 0; i< m_objects.size(); ++i)
+        {
+            Object const& object = m_objects [i];
+            if(object.kind != Object::Table)
+                continue;
+
+            lua_rawgeti(L, store, static_cast<int>(i + 1));
+            for(size_t f = 0; f< object.fields.size(); ++f)
+            {
+                Push(L, store, object.fields [f].first);
+                Push(L, store, object.fields [f].second);
+                lua_rawset(L, -3);
+            }
+            if(object.metatable.kind != Value::Nil)
+            {
+                Push(L, store, object.metatable);
+                lua_setmetatable(L, -2);
+            }
+            lua_pop(L, 1);
+        }
+
+        luaS_pushglobaltable(L);
+        for(size_t i = 0; i< m_globals.size(); ++i)
+        {
+            lua_pushlstring(L, m_globals [i].first.data(), m_globals [i].first.size());
+            Push(L, store, m_globals [i].second);
+            lua_rawset(L, -3);
+        }
+        lua_pop(L, 1);
+
+        for(size_t i = 0; i< m_registry.size(); ++i)
+        {
+            Push(L, store, m_registry [i].second);
+            lua_rawsetp(L, LUA_REGISTRYINDEX, m_registry [i].first);
+        }
+
+        lua_settop(L, top);
+    }
+
+    /** The number of tables, closures and userdata created by Apply(). */
+    size_t GetObjectCount() const
+    {
+        return m_objects.size();
+    }
+
+private:
+    struct Value
+    {
+        enum Kind
+        {
+            Nil,
+            Boolean,
+            Number,
+            Integer,
+            String,
+            LightUserdata,
+            Object,
+            Path
+        };
+
+        Value()
+        : kind(Nil)
+        , boolean(false)
+        , number(0)
+        , integer(0)
+        , pointer(NULL)
+        , index(0)
+        {
+        }
+
+        Kind kind;
+        bool boolean;
+        lua_Number number;
+        lua_Integer integer;
+        std::string string;
+        void* pointer;
+        /** The object id or path index. */
+        int index;
+    };
+
+    struct Object
+    {
+        enum Kind
+        {
+            Table,
+            Function,
+            Userdata
+        };
+
+        Object()
+        : kind(Table)
+        , narr(0)
+        , nrec(0)
+        , function(NULL)
+        {
+        }
+
+        Kind kind;
+        int narr;
+        int nrec;
+        std::vector<std::pair<Value, Value> > fields;
+        Value metatable;
+        lua_CFunction function;
+        std::vector<Value> upvalues;
+        std::string bytes;
+    };
+
+    /** A chain of string keys from the globals or the registry. */
+    struct Path
+    {
+        Path()
+        : fromRegistry(false)
+        {
+        }
+
+        bool fromRegistry;
+        std::vector<std::string> keys;
+    };
+
+    void Push(lua_State* L, int store, Value const& value) const
+    {
+        switch(value.kind)
+        {
+            case Value::Nil:
+                lua_pushnil(L);
+                break;
+
+            case Value::Boolean:
+                lua_pushboolean(L, value.boolean ? 1 : 0);
+                break;
+
+            case Value::Number:
+                lua_pushnumber(L, value.number);
+                break;
+
+            case Value::Integer:
+                lua_pushinteger(L, value.integer);
+                break;
+
+            case Value::String:
+                lua_pushlstring(L, value.string.data(), value.string.size());
+                break;
+
+            case Value::LightUserdata:
+                lua_pushlightuserdata(L, value.pointer);
+                break;
+
+            case Value::Object:
+                lua_rawgeti(L, store, value.index + 1);
+                break;
+
+            case Value::Path:
+            {
+                Path const& path = m_paths [value.index];
+                if(path.fromRegistry)
+                    lua_pushvalue(L, LUA_REGISTRYINDEX);
+                else
+                    luaS_pushglobaltable(L);
+                for(size_t i = 0; i< path.keys.size() && lua_istable(L, -1); ++i)
+                {
+                    rawgetfield(L, -1, path.keys [i].c_str());
+                    lua_remove(L, -2);
+                }
+                break;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    /**
+     Walks the scratch state and fills in a snapshot.
+     */
+    class Capturer
+    {
+    public:
+        Capturer(RegistrationSnapshot& snapshot, lua_State* L)
+        : m_snapshot(snapshot)
+        , L(L)
+        , m_store(0)
+        {
+        }
+
+        void Run(Registration const& registration)
+        {
+            int const top = lua_gettop(L);
+
+            // Remember what a fresh state looks like.
+            luaS_pushglobaltable(L);
+            int const globals = lua_gettop(L);
+            AddBaseline(globals, Path());
+            Path registryPath;
+            registryPath.fromRegistry = true;
+            AddBaseline(LUA_REGISTRYINDEX, registryPath);
+
+            int const oldGlobals = ShallowCopy(globals, LUA_TSTRING);
+            int const oldRegistry = ShallowCopy(LUA_REGISTRYINDEX, LUA_TLIGHTUSERDATA);
+
+            registration(L);
+            lua_settop(L, oldRegistry);
+
+            lua_newtable(L);
+            m_store = lua_gettop(L);
+
+            lua_pushnil(L);
+            while(lua_next(L, globals))
+            {
+                if(lua_type(L, -2) == LUA_TSTRING && !IsUnchanged(oldGlobals))
+                {
+                    size_t len = 0;
+                    char const* name = lua_tolstring(L, -2, &len);
+                    m_snapshot.m_globals.push_back(std::make_pair(std::string(name, len), ToValue(lua_gettop(L))));
+                }
+                lua_pop(L, 1);
+            }
+
+            lua_pushnil(L);
+            while(lua_next(L, LUA_REGISTRYINDEX))
+            {
+                if(lua_type(L, -2) == LUA_TLIGHTUSERDATA && !IsUnchanged(oldRegistry))
+                {
+                    m_snapshot.m_registry.push_back(std::make_pair(lua_touserdata(L, -2), ToValue(lua_gettop(L))));
+                }
+                lua_pop(L, 1);
+            }
+
+            // Record the fields of the discovered tables, which may discover more.
+            for(size_t next = 0; next< m_pending.size(); ++next)
+            {
+                RecordTable(m_pending [next]);
+            }
+
+            lua_settop(L, top);
+        }
+
+    private:
+        /** Record every table and function reachable from the table at
+            index through string keys, with the path leading to it.
+         */
+        void AddBaseline(int index, Path const& path)
+        {
+            index = lua_absindex(L, index);
+            m_baseline [lua_topointer(L, index)] = path;
+
+            lua_pushnil(L);
+            while(lua_next(L, index))
+            {
+                int const type = lua_type(L, -1);
+                if(lua_type(L, -2) == LUA_TSTRING &&
+                   (type == LUA_TTABLE || type == LUA_TFUNCTION || type == LUA_TUSERDATA) &&
+                   m_baseline.find(lua_topointer(L, -1)) == m_baseline.end())
+                {
+                    Path child = path;
+                    child.keys.push_back(lua_tostring(L, -2));
+                    if(type == LUA_TTABLE)
+                        AddBaseline(-1, child);
+                    else
+                        m_baseline [lua_topointer(L, -1)] = child;
+                }
+                lua_pop(L, 1);
+            }
+        }
+
+        /** Push a copy of the entries of the table at index whose keys are
+            of the given type, and return its index.
+         */
+        int ShallowCopy(int index, int keyType)
+        {
+            lua_newtable(L);
+            int const copy = lua_gettop(L);
+            lua_pushnil(L);
+            while(lua_next(L, index))
+            {
+                if(lua_type(L, -2) == keyType)
+                {
+                    lua_pushvalue(L, -2);
+                    lua_insert(L, -2);
+                    lua_rawset(L, copy);
+                }
+                else
+                {
+                    lua_pop(L, 1);
+                }
+            }
+            return copy;
+        }
+
+        /** True if the key and value on top of the stack are also in old. */
+        bool IsUnchanged(int old)
+        {
+            lua_pushvalue(L, -2);
+            lua_rawget(L, old);
+            bool const unchanged = lua_rawequal(L, -1, -2) != 0;
+            lua_pop(L, 1);
+            return unchanged;
+        }
+
+        Value ToValue(int index)
+        {
+            Value value;
+            switch(lua_type(L, index))
+            {
+                case LUA_TNIL:
+                    break;
+
+                case LUA_TBOOLEAN:
+                    value.kind = Value::Boolean;
+                    value.boolean = lua_toboolean(L, index) != 0;
+                    break;
+
+                case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+                    if(lua_isinteger(L, index))
+                    {
+                        value.kind = Value::Integer;
+                        value.integer = lua_tointeger(L, index);
+                        break;
+                    }
+#endif
+                    value.kind = Value::Number;
+                    value.number = lua_tonumber(L, index);
+                    break;
+
+                case LUA_TSTRING:
+                {
+                    size_t len = 0;
+                    char const* s = lua_tolstring(L, index, &len);
+                    value.kind = Value::String;
+                    value.string.assign(s, len);
+                    break;
+                }
+
+                case LUA_TLIGHTUSERDATA:
+                    value.kind = Value::LightUserdata;
+                    value.pointer = lua_touserdata(L, index);
+                    break;
+
+                case LUA_TTABLE:
+                case LUA_TFUNCTION:
+                case LUA_TUSERDATA:
+                    value = ToObject(index);
+                    break;
+
+                default:
+                    throw std::logic_error("RegistrationSnapshot: cannot capture a thread");
+            }
+            return value;
+        }
+
+        Value ToObject(int index)
+        {
+            Value value;
+            void const* p = lua_topointer(L, index);
+
+            std::unordered_map<void const*, int>::const_iterator const known = m_ids.find(p);
+            if(known != m_ids.end())
+            {
+                // Negative ids stand for recorded paths.
+                value.kind = known->second >= 0 ? Value::Object : Value::Path;
+                value.index = known->second >= 0 ? known->second : -1 - known->second;
+                return value;
+            }
+
+            std::unordered_map<void const*, Path>::const_iterator const baseline = m_baseline.find(p);
+            if(baseline != m_baseline.end())
+            {
+                value.kind = Value::Path;
+                value.index = static_cast<int>(m_snapshot.m_paths.size());
+                m_snapshot.m_paths.push_back(baseline->second);
+                m_ids [p] = -1 - value.index;
+                return value;
+            }
+
+            Object object;
+            if(lua_istable(L, index))
+            {
+                // Fields are recorded later, after every object the table
+                // refers to has been discovered.
+                object.kind = Object::Table;
+                m_pending.push_back(static_cast<int>(m_snapshot.m_objects.size()));
+                lua_pushvalue(L, index);
+                lua_rawseti(L, m_store, static_cast<int>(m_snapshot.m_objects.size() + 1));
+            }
+            else if(lua_isuserdata(L, index))
+            {
+                if(lua_getmetatable(L, index))
+                {
+                    lua_pop(L, 1);
+                    throw std::logic_error("RegistrationSnapshot: cannot capture userdata with a metatable");
+                }
+                object.kind = Object::Userdata;
+                object.bytes.assign(static_cast<char const*>(lua_touserdata(L, index)), lua_rawlen(L, index));
+            }
+            else
+            {
+                if(!lua_iscfunction(L, index))
+                    throw std::logic_error("RegistrationSnapshot: cannot capture a Lua function");
+
+                object.kind = Object::Function;
+                object.function = lua_tocfunction(L, index);
+                for(int n = 1; lua_getupvalue(L, index, n) != NULL; ++n)
+                {
+                    object.upvalues.push_back(ToValue(lua_gettop(L)));
+                    lua_pop(L, 1);
+                }
+            }
+
+            value.kind = Value::Object;
+            value.index = static_cast<int>(m_snapshot.m_objects.size());
+            m_ids [p] = value.index;
+            m_snapshot.m_objects.push_back(object);
+            return value;
+        }
+
+        void RecordTable(int id)
+        {
+            lua_rawgeti(L, m_store, id + 1);
+            int const table = lua_gettop(L);
+
+            std::vector<std::pair<Value, Value> > fields;
+            int narr = 0;
+            lua_pushnil(L);
+            while(lua_next(L, table))
+            {
+                if(lua_type(L, -2) == LUA_TNUMBER && lua_tonumber(L, -2) == narr + 1)
+                    ++narr;
+                Value const key = ToValue(lua_gettop(L) - 1);
+                fields.push_back(std::make_pair(key, ToValue(lua_gettop(L))));
+                lua_pop(L, 1);
+            }
+
+            Value metatable;
+            if(lua_getmetatable(L, table))
+            {
+                metatable = ToValue(lua_gettop(L));
+                lua_pop(L, 1);
+            }
+            lua_pop(L, 1);
+
+            Object& object = m_snapshot.m_objects [id];
+            object.narr = narr;
+            object.nrec = static_cast<int>(fields.size()) - narr;
+            object.fields.swap(fields);
+            object.metatable = metatable;
+        }
+
+        RegistrationSnapshot& m_snapshot;
+        lua_State* const L;
+        int m_store;
+        std::unordered_map<void const*, Path> m_baseline;
+        std::unordered_map<void const*, int> m_ids;
+        std::vector<int> m_pending;
+    };
+
+    std::vector<Object> m_objects;
+    std::vector<Path> m_paths;
+    std::vector<std::pair<std::string, Value> > m_globals;
+    std::vector<std::pair<void*, Value> > m_registry;
+};
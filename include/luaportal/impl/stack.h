@@ -850,6 +850,219 @@ struct Stack<std::string const&>
     }
 };
 
+//------------------------------------------------------------------------------
+/**
+ Stack specialization for `StringRef`.
+ */
+template<>
+struct Stack<StringRef>
+{
+    static inline void Push(lua_State* L, StringRef const& str)
+    {
+        lua_pushlstring(L, str.data(), str.size());
+    }
+    
+    static inline StringRef Get(lua_State* L, int index)
+    {
+        size_t len;
+        const char *str = luaL_checklstring(L, index, &len);
+        return StringRef(str, len);
+    }
+
+    static inline bool CheckType(lua_State* L, int index)
+    {
+        return lua_type(L, index) == LUA_TSTRING;
+    }
+
+    static inline StringRef DefaultValue(lua_State* L, int)
+    {
+        return StringRef();
+    }
+
+    static inline const char * RequireType()
+    {
+        return "luaportal::StringRef";
+    }
+};
+
+//------------------------------------------------------------------------------
+/**
+ Stack specialization for `StringRef const&`.
+ */
+template<>
+struct Stack<StringRef const&>
+{
+    static inline void Push(lua_State* L, StringRef const& str)
+    {
+        lua_pushlstring(L, str.data(), str.size());
+    }
+    
+    static inline StringRef Get(lua_State* L, int index)
+    {
+        size_t len;
+        const char *str = luaL_checklstring(L, index, &len);
+        return StringRef(str, len);
+    }
+
+    static inline bool CheckType(lua_State* L, int index)
+    {
+        return lua_type(L, index) == LUA_TSTRING;
+    }
+
+    static inline StringRef DefaultValue(lua_State* L, int)
+    {
+        return StringRef();
+    }
+
+    static inline const char * RequireType()
+    {
+        return "luaportal::StringRef const &";
+    }
+};
+
+//------------------------------------------------------------------------------
+/**
+ Stack specialization for `ByteSpan`.
+ */
+template<>
+struct Stack<ByteSpan>
+{
+    static inline void Push(lua_State* L, ByteSpan const& str)
+    {
+        lua_pushlstring(L, reinterpret_cast<char const*>(str.data()), str.size());
+    }
+    
+    static inline ByteSpan Get(lua_State* L, int index)
+    {
+        size_t len;
+        const char *str = luaL_checklstring(L, index, &len);
+        return ByteSpan(str, len);
+    }
+
+    static inline bool CheckType(lua_State* L, int index)
+    {
+        return lua_type(L, index) == LUA_TSTRING;
+    }
+
+    static inline ByteSpan DefaultValue(lua_State* L, int)
+    {
+        return ByteSpan();
+    }
+
+    static inline const char * RequireType()
+    {
+        return "luaportal::ByteSpan";
+    }
+};
+
+//------------------------------------------------------------------------------
+/**
+ Stack specialization for `ByteSpan const&`.
+ */
+template<>
+struct Stack<ByteSpan const&>
+{
+    static inline void Push(lua_State* L, ByteSpan const& str)
+    {
+        lua_pushlstring(L, reinterpret_cast<char const*>(str.data()), str.size());
+    }
+    
+    static inline ByteSpan Get(lua_State* L, int index)
+    {
+        size_t len;
+        const char *str = luaL_checklstring(L, index, &len);
+        return ByteSpan(str, len);
+    }
+
+    static inline bool CheckType(lua_State* L, int index)
+    {
+        return lua_type(L, index) == LUA_TSTRING;
+    }
+
+    static inline ByteSpan DefaultValue(lua_State* L, int)
+    {
+        return ByteSpan();
+    }
+
+    static inline const char * RequireType()
+    {
+        return "luaportal::ByteSpan const &";
+    }
+};
+
+#ifdef LUAPORTAL_HAS_STRING_VIEW
+
+//------------------------------------------------------------------------------
+/**
+ Stack specialization for `std::string_view`.
+ */
+template<>
+struct Stack<std::string_view>
+{
+    static inline void Push(lua_State* L, std::string_view str)
+    {
+        lua_pushlstring(L, str.data(), str.size());
+    }
+    
+    static inline std::string_view Get(lua_State* L, int index)
+    {
+        size_t len;
+        const char *str = luaL_checklstring(L, index, &len);
+        return std::string_view(str, len);
+    }
+
+    static inline bool CheckType(lua_State* L, int index)
+    {
+        return lua_type(L, index) == LUA_TSTRING;
+    }
+
+    static inline std::string_view DefaultValue(lua_State* L, int)
+    {
+        return std::string_view();
+    }
+
+    static inline const char * RequireType()
+    {
+        return "std::string_view";
+    }
+};
+
+//------------------------------------------------------------------------------
+/**
+ Stack specialization for `std::string_view const&`.
+ */
+template<>
+struct Stack<std::string_view const&>
+{
+    static inline void Push(lua_State* L, std::string_view str)
+    {
+        lua_pushlstring(L, str.data(), str.size());
+    }
+    
+    static inline std::string_view Get(lua_State* L, int index)
+    {
+        size_t len;
+        const char *str = luaL_checklstring(L, index, &len);
+        return std::string_view(str, len);
+    }
+
+    static inline bool CheckType(lua_State* L, int index)
+    {
+        return lua_type(L, index) == LUA_TSTRING;
+    }
+
+    static inline std::string_view DefaultValue(lua_State* L, int)
+    {
+        return std::string_view();
+    }
+
+    static inline const char * RequireType()
+    {
+        return "std::string_view const &";
+    }
+};
+#endif
+
 static inline int PushArgs(lua_State *L)
 {
     return 0;
@@ -874,32 +1087,55 @@ public:
         }
     }
     
+    /**
+     Push the message handler and the referenced function.
+     
+     Returns the stack index of the message handler, everything from there
+     up is removed with a single lua_settop once the call returns.
+     */
+    int PushCall() const
+    {
+        lua_pushcfunction(state, &ShowDebugMessage);
+        lua_rawgeti(state, LUA_REGISTRYINDEX, ref);
+        return lua_gettop(state) - 1;
+    }
+    
+    /**
+     Report a result of the wrong type. This is the cold path, the traceback
+     is only built here.
+     */
+    template<typename R, typename... P>
+    static R ReturnTypeError(lua_State *L, int base)
+    {
+        REDLOG("return type error: expected '" << Stack<R>::RequireType() << "', but got '" << lua_typename(L, lua_type(L, -1)) << "'\n\t in function "<<typeid(R(P...)).name());
+        R value = Stack<R>::DefaultValue(L, -1);
+        luaS_traceback(L);
+        REDLOG(lua_tostring(L, -1));
+        lua_settop(L, base - 1);
+        return value;
+    }
+    
     template<typename R , typename... P>
     static void create(lua_State *L, int index, std::function<R(P...)> &func)
     {
         auto auf = std::make_shared<FunctionTransfer>(L, index);
         func = [auf](P... p)->R{
             lua_State *L = auf->getState();
-            lua_pushcfunction(L, &ShowDebugMessage);
-            auto debugfunc = lua_gettop(L);
-            lua_rawgeti(L, LUA_REGISTRYINDEX, auf->getRef());
+            int const base = auf->PushCall();
             int nargs = PushArgs(L, p...);
-            lua_pcall(L, nargs, 1, debugfunc);
-            lua_remove(L, debugfunc);
-            if (!Stack<R>::CheckType(L, -1))
+            if(lua_pcall(L, nargs, 1, base) != LUAPORTAL_LUA_OK)
             {
-                REDLOG("return type error: expected '" << Stack<R>::RequireType() << "', but got '" << lua_typename(L, lua_type(L, -1)) << "'\n\t in function "<<typeid(R(P...)).name());
+                // The message handler has already reported the error.
                 R value = Stack<R>::DefaultValue(L, -1);
-                lua_pop(L, 1);
-                lua_getglobal(L, "debug");
-                lua_getfield(L, -1, "traceback");
-                lua_pcall(L, 0, 1, 0);
-                REDLOG(Stack<std::string>::Get(L, -1));
-                lua_pop(L, 2);
+                lua_settop(L, base - 1);
                 return value;
             }
+            if (!Stack<R>::CheckType(L, -1))
+            {
+                return ReturnTypeError<R, P...>(L, base);
+            }
             R value = Stack<R>::Get(L, -1);
-            lua_pop(L, 1);
+            lua_settop(L, base - 1);
             return value;
         };
     }
@@ -910,12 +1146,10 @@ public:
         auto auf = std::make_shared<FunctionTransfer>(L, index);
         func = [auf](P... p)->void{
             lua_State *L = auf->getState();
-            lua_pushcfunction(L, &ShowDebugMessage);
-            auto debugfunc = lua_gettop(L);
-            lua_rawgeti(L, LUA_REGISTRYINDEX, auf->getRef());
+            int const base = auf->PushCall();
             int nargs = PushArgs(L, p...);
-            lua_pcall(L, nargs, 0, debugfunc);
-            lua_remove(L, debugfunc);
+            lua_pcall(L, nargs, 0, base);
+            lua_settop(L, base - 1);
         };
     }
     
@@ -925,11 +1159,9 @@ public:
         auto auf = std::make_shared<FunctionTransfer>(L, index);
         func = [auf]()->void{
             lua_State *L = auf->getState();
-            lua_pushcfunction(L, &ShowDebugMessage);
-            auto debugfunc = lua_gettop(L);
-            lua_rawgeti(L, LUA_REGISTRYINDEX, auf->getRef());
-            lua_pcall(L, 0, 0, debugfunc);
-            lua_remove(L, debugfunc);
+            int const base = auf->PushCall();
+            lua_pcall(L, 0, 0, base);
+            lua_settop(L, base - 1);
         };
     }
     
@@ -968,7 +1200,7 @@ struct Stack<std::function<FT> >
     static inline void Push(lua_State* L, std::function<FT> func)
     {
         if(func) {
-            new(lua_newuserdata(L, sizeof(func))) std::function<FT>(func);
+            new(luaS_newuserdata(L, sizeof(func), 0)) std::function<FT>(func);
             luaL_newmetatable(L, typeid(func).name());
             lua_pushvalue(L, -2);
             lua_pushcclosure(L, &StaticLambda<std::function<FT>>::Call, 1);
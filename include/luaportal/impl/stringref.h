@@ -0,0 +1,117 @@
+//==============================================================================
+/**
+ A non-owning reference to the characters of a Lua string.
+
+ Stack<StringRef>::Get points directly into the string owned by the Lua
+ state instead of copying it into a std::string, which makes it suitable
+ for large arguments of bound functions.
+
+ Lifetime: the referenced characters stay valid only as long as the Lua
+ value they came from is alive, which for a function argument is the
+ duration of the call. Do not store a StringRef, do not use it as the
+ result type of a Lua callback(the result is popped before the caller sees
+ it), and call ToString() to keep a copy.
+ */
+class StringRef
+{
+public:
+    typedef char const* const_iterator;
+
+    StringRef()
+    : m_data("")
+    , m_size(0)
+    {
+    }
+
+    StringRef(char const* data, size_t size)
+    : m_data(data)
+    , m_size(size)
+    {
+    }
+
+    StringRef(char const* str)
+    : m_data(str)
+    , m_size(strlen(str))
+    {
+    }
+
+    StringRef(std::string const& str)
+    : m_data(str.c_str())
+    , m_size(str.size())
+    {
+    }
+
+    char const* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const_iterator begin() const { return m_data; }
+    const_iterator end() const { return m_data + m_size; }
+
+    char operator[](size_t i) const
+    {
+        return m_data [i];
+    }
+
+    /** Copy the characters into a std::string.
+     */
+    std::string ToString() const
+    {
+        return std::string(m_data, m_size);
+    }
+
+    bool operator==(StringRef const& rhs) const
+    {
+        return m_size == rhs.m_size && memcmp(m_data, rhs.m_data, m_size) == 0;
+    }
+
+    bool operator!=(StringRef const& rhs) const
+    {
+        return !(*this == rhs);
+    }
+
+private:
+    char const* m_data;
+    size_t m_size;
+};
+
+//==============================================================================
+/**
+ A read-only, non-owning view of binary data held in a Lua string.
+
+ Lua strings may contain embedded zeros, which makes them the natural
+ carrier for serialized blobs. ByteSpan exposes the bytes without a copy,
+ with the same lifetime rules as StringRef. Pushing a ByteSpan creates a
+ new Lua string holding a copy of the bytes.
+ */
+class ByteSpan
+{
+public:
+    typedef unsigned char const* const_iterator;
+
+    ByteSpan()
+    : m_data(0)
+    , m_size(0)
+    {
+    }
+
+    ByteSpan(void const* data, size_t size)
+    : m_data(static_cast<unsigned char const*>(data))
+    , m_size(size)
+    {
+    }
+
+    unsigned char const* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const_iterator begin() const { return m_data; }
+    const_iterator end() const { return m_data + m_size; }
+
+    unsigned char operator[](size_t i) const
+    {
+        return m_data [i];
+    }
+
+private:
+    unsigned char const* m_data;
+    size_t m_size;
+};
@@ -28,14 +28,69 @@ inline void* GetIdentityKey()
     return &value;
 }
 
+/**
+ The alignment Lua guarantees for the block of a userdata, after
+ L_Umaxalign and LUAI_USER_ALIGNMENT_T in the Lua sources.
+ */
+union UserdataAlignment
+{
+    double n;
+    void* p;
+    long l;
+    long long i;
+};
+
 /**
  Interface to a class pointer retrievable from a userdata.
+ 
+ The userdata have no virtual functions. The header records how the object
+ is held, and Destroy() finds the destructor to run from that: the class
+ record for an object held by value, the function set by the derived class
+ for a container.
  */
 class Userdata
 {
+    friend class UserdataSharedOwner;
+    
 protected:
+    /** How the userdata holds the object.
+     */
+    enum Storage
+    {
+        PointerStorage,      // not owned, or a value not constructed yet
+        ValueStorage,        // in the block, destroyed by the class record
+        ContainerStorage,    // a UserdataHolder
+        SharedOwnerStorage   // a UserdataSharedOwner
+    };
+    
     void* m_p; // subclasses must set this
     
+    // Header used by the fast type check, set when the userdata is pushed.
+    void const* m_identity;
+    ClassRecord const* m_record;
+    bool m_isConst;
+    unsigned char m_storage;
+    
+    Userdata()
+    : m_p(0)
+    , m_identity(GetIdentityKey())
+    , m_record(0)
+    , m_isConst(false)
+    , m_storage(PointerStorage)
+    {
+    }
+    
+    //--------------------------------------------------------------------------
+    /**
+     Record the registered class of the object and whether it was pushed
+     with the const table.
+     */
+    void SetClass(ClassRecord const& record, bool isConst)
+    {
+        m_record = &record;
+        m_isConst = isConst;
+    }
+    
     //--------------------------------------------------------------------------
     /**
      Get an untyped pointer to the contained class.
@@ -46,6 +101,42 @@ protected:
     }
     
 private:
+    //--------------------------------------------------------------------------
+    /**
+     Return the Userdata at index if it is one of ours, without consulting
+     its metatable, or null.
+     
+     Scripts cannot create a userdata, so the identity pointer stored in the
+     header only appears in userdata created by LuaPortal.
+     */
+    static Userdata* GetHeader(lua_State* L, int index)
+    {
+        if(lua_type(L, index) != LUA_TUSERDATA || lua_rawlen(L, index) < sizeof(Userdata))
+            return 0;
+        
+        Userdata* const ud = static_cast<Userdata*>(lua_touserdata(L, index));
+        if(ud->m_identity != GetIdentityKey() || ud->m_record == 0)
+            return 0;
+        
+        return ud;
+    }
+    
+    //--------------------------------------------------------------------------
+    /**
+     Fast type check on the userdata header.
+     
+     Returns null when the check fails, the caller then takes the slow path
+     which produces the error message.
+     */
+    static inline Userdata* GetDerived(lua_State* L, int index,
+                                       ClassRecord const& base, bool canBeConst)
+    {
+        Userdata* const ud = GetHeader(L, index);
+        if(ud != 0 && ud->m_record->IsA(base) && (canBeConst || !ud->m_isConst))
+            return ud;
+        return 0;
+    }
+    
     //--------------------------------------------------------------------------
     /**
      Validate and retrieve a Userdata on the stack.
@@ -97,7 +188,7 @@ private:
             }
             else
             {
-                rawgetfield(L, -2, "__const");
+                rawgetkey(L, -2, ConstKey);
                 if(lua_rawequal(L, -1, -2))
                 {
                     // Matches const table
@@ -107,7 +198,7 @@ private:
                 else
                 {
                     // Mismatch, but its one of ours so Get a type name.
-                    rawgetfield(L, -2, "__type");
+                    rawgetkey(L, -2, TypeKey);
                     lua_insert(L, -4);
                     lua_pop(L, 2);
                     got = lua_tostring(L, -2);
@@ -118,7 +209,7 @@ private:
         
         if(mismatch)
         {
-            rawgetfield(L, -1, "__type");
+            rawgetkey(L, -1, TypeKey);
             assert(lua_type(L, -1) == LUA_TSTRING);
             char const* const expected = lua_tostring(L, -1);
             
@@ -171,7 +262,7 @@ private:
                 lua_pop(L, 1);
                 
                 // If __const is present, object is NOT const.
-                rawgetfield(L, -1, "__const");
+                rawgetkey(L, -1, ConstKey);
                 assert(lua_istable(L, -1) || lua_isnil(L, -1));
                 bool const IsConst = lua_isnil(L, -1);
                 lua_pop(L, 1);
@@ -179,7 +270,7 @@ private:
                 // Replace the class table with the const table if needed.
                 if(IsConst)
                 {
-                    rawgetfield(L, -2, "__const");
+                    rawgetkey(L, -2, ConstKey);
                     assert(lua_istable(L, -1));
                     lua_replace(L, -3);
                 }
@@ -204,7 +295,7 @@ private:
                     else
                     {
                         // Replace current metatable with it's base class.
-                        rawgetfield(L, -1, "__parent");
+                        rawgetkey(L, -1, ParentKey);
                         /*
                          ud
                          class metatable
@@ -216,7 +307,7 @@ private:
                         {
                             lua_remove(L, -1);
                             // Mismatch, but its one of ours so Get a type name.
-                            rawgetfield(L, -1, "__type");
+                            rawgetkey(L, -1, TypeKey);
                             lua_insert(L, -3);
                             lua_pop(L, 1);
                             got = lua_tostring(L, -2);
@@ -244,7 +335,7 @@ private:
         if(mismatch)
         {
             assert(lua_type(L, -1) == LUA_TTABLE);
-            rawgetfield(L, -1, "__type");
+            rawgetkey(L, -1, TypeKey);
             assert(lua_type(L, -1) == LUA_TSTRING);
             char const* const expected = lua_tostring(L, -1);
             
@@ -288,7 +379,7 @@ private:
                 lua_pop(L, 1);
 
                 // If __const is present, object is NOT const.
-                rawgetfield(L, -1, "__const");
+                rawgetkey(L, -1, ConstKey);
                 if (!(lua_istable(L, -1) || lua_isnil(L, -1)))
                 {
                     return false;
@@ -299,7 +390,7 @@ private:
                 // Replace the class table with the const table if needed.
                 if (IsConst)
                 {
-                    rawgetfield(L, -2, "__const");
+                    rawgetkey(L, -2, ConstKey);
                     if (!lua_istable(L, -1))
                     {
                         return false;
@@ -327,7 +418,7 @@ private:
                     else
                     {
                         // Replace current metatable with it's base class.
-                        rawgetfield(L, -1, "__parent");
+                        rawgetkey(L, -1, ParentKey);
                         /*
                         ud
                         class metatable
@@ -339,7 +430,7 @@ private:
                         {
                             lua_remove(L, -1);
                             // Mismatch, but its one of ours so Get a type name.
-                            rawgetfield(L, -1, "__type");
+                            rawgetkey(L, -1, TypeKey);
                             lua_insert(L, -3);
                             lua_pop(L, 1);
                             got = lua_tostring(L, -2);
@@ -370,7 +461,7 @@ private:
             {
                 return false;
             }
-            rawgetfield(L, -1, "__type");
+            rawgetkey(L, -1, TypeKey);
             if (!(lua_type(L, -1) == LUA_TSTRING))
             {
                 return false;
@@ -390,7 +481,11 @@ private:
     }
     
 public:
-    virtual ~Userdata() { }
+    //--------------------------------------------------------------------------
+    /**
+     Destroy the object held by the userdata, this is the __gc metamethod.
+     */
+    inline void Destroy();
     
     //--------------------------------------------------------------------------
     /**
@@ -401,6 +496,9 @@ public:
     template<typename T>
     static inline Userdata* GetExact(lua_State* L, int index)
     {
+        Userdata* const ud = GetHeader(L, index);
+        if(ud != 0 && ud->m_record == &ClassInfo<T>::GetRecord())
+            return ud;
         return GetExactClass(L, index, ClassInfo<T>::GetClassKey());
     }
     
@@ -420,11 +518,88 @@ public:
         }
         else
         {
+            Userdata* const ud = GetDerived(L, index, ClassInfo<T>::GetRecord(), canBeConst);
+            if(ud != 0)
+                return static_cast<T*>(ud->GetPointer());
             return static_cast<T*>(GetClass(L, index,
                 ClassInfo<T>::GetClassKey(), canBeConst)->GetPointer());
         }
     }
 
+    //--------------------------------------------------------------------------
+    /**
+     Push the extension table of the object at index, the user value which
+     holds the fields scripts add to objects of extensible classes.
+     
+     If the object has no table yet, one is created when create is true and
+     the object is not const. Returns false, with nothing pushed, when there
+     is no table.
+     */
+    static bool PushExtension(lua_State* L, int index, bool create)
+    {
+        Userdata* const ud = GetHeader(L, index);
+        if(ud == 0 || !lua_getmetatable(L, index))
+            return false;
+        bool const isExtensible = IsExtensible(L);
+        lua_pop(L, 1);
+        if(!isExtensible)
+            return false;
+        
+        luaS_getuservalue(L, index);
+        if(lua_istable(L, -1))
+            return true;
+        lua_pop(L, 1);
+        
+        if(!create || ud->m_isConst)
+            return false;
+        
+        index = lua_absindex(L, index);
+        lua_newtable(L);
+        lua_pushvalue(L, -1);
+        if(!luaS_setuservalue(L, index))
+        {
+            // Pushed before the class was made extensible.
+            lua_pop(L, 1);
+            return false;
+        }
+        return true;
+    }
+    
+    //--------------------------------------------------------------------------
+    /**
+     Returns true if the class or const table on top of the stack belongs to
+     an extensible class of this lua_State.
+     */
+    static bool IsExtensible(lua_State* L)
+    {
+        rawgetkey(L, -1, ExtensibleKey);
+        bool const isExtensible = lua_toboolean(L, -1) != 0;
+        lua_pop(L, 1);
+        return isExtensible;
+    }
+    
+    //--------------------------------------------------------------------------
+    /**
+     The number of user values to create a userdata with, whose metatable is
+     registered under key.
+     
+     Only Lua 5.4 sizes the user values of a userdata, earlier versions skip
+     the lookup.
+     */
+    static int UserValueCount(lua_State* L, void const* key)
+    {
+#if LUA_VERSION_NUM >= 504
+        lua_rawgetp(L, LUA_REGISTRYINDEX, key);
+        int const count = lua_istable(L, -1) && IsExtensible(L) ? 1 : 0;
+        lua_pop(L, 1);
+        return count;
+#else
+        (void)L;
+        (void)key;
+        return 0;
+#endif
+    }
+    
     template<typename T>
     static inline bool CheckType(lua_State* L, int index, bool canBeConst)
     {
@@ -432,6 +607,10 @@ public:
         {
             return true;
         }
+        else if(GetDerived(L, index, ClassInfo<T>::GetRecord(), canBeConst) != 0)
+        {
+            return true;
+        }
         else
         {
             return CheckClass(L, index, ClassInfo<T>::GetClassKey(), canBeConst);
@@ -450,19 +629,18 @@ template<typename T>
 class UserdataValue : public Userdata
 {
 private:
-    bool constructed = false;
     UserdataValue<T>(UserdataValue<T> const&);
     UserdataValue<T> operator=(UserdataValue<T> const&);
     
-    char m_storage [sizeof(T)];
-    
-    inline T* GetObject()
+    enum
     {
-        // If this fails to compile it means you forgot to provide
-        // a Container specialization for your container!
-        //
-        return reinterpret_cast<T*>(&m_storage [0]);
-    }
+        // The object follows the header, at its own alignment.
+        Offset = (sizeof(Userdata) + alignof(T) - 1) / alignof(T) * alignof(T),
+        
+        // Lua aligns the block for its own types only, an over-aligned T is
+        // moved forward within the block.
+        Slack = alignof(T) > alignof(UserdataAlignment) ? alignof(T) - alignof(UserdataAlignment) : 0
+    };
     
 private:
     /**
@@ -470,14 +648,8 @@ private:
      */
     UserdataValue()
     {
-        m_p = GetObject();
-    }
-    
-    ~UserdataValue()
-    {
-        if(constructed) {
-            GetObject()->~T();
-        } 
+        uintptr_t const start = reinterpret_cast<uintptr_t>(this) + Offset;
+        m_p = reinterpret_cast<void*>((start + alignof(T) - 1) & ~static_cast<uintptr_t>(alignof(T) - 1));
     }
     
 public:
@@ -490,7 +662,8 @@ public:
     static UserdataValue<T>* place(lua_State* const L)
     {
         UserdataValue<T>* const ud = new(
-                                           lua_newuserdata(L, sizeof(UserdataValue<T>))) UserdataValue<T>();
+                                           luaS_newuserdata(L, Offset + sizeof(T) + Slack, UserValueCount(L, ClassInfo<T>::GetClassKey()))) UserdataValue<T>();
+        ud->SetClass(ClassInfo<T>::GetRecord(), false);
         lua_rawgetp(L, LUA_REGISTRYINDEX, ClassInfo<T>::GetClassKey());
         // If this goes off it means you forgot to register the class!
         assert(lua_istable(L, -1));
@@ -505,7 +678,7 @@ public:
     
     void markConstructed()
     {
-        constructed = true;
+        m_storage = ValueStorage;
     }
     
     /**
@@ -533,46 +706,66 @@ private:
     UserdataPtr operator=(UserdataPtr const&);
     
 private:
-    /** Push non-const pointer to object using metatable key.
+    /** Push non-null pointer to object using metatable key.
+     
+     When the metatable holds a pointer cache, a weak valued table kept under
+     CacheKey by Class::CachePointers(), the userdata cached for p is reused
+     and a new one is stored on a miss. An entry goes away with its userdata,
+     so holding it does not keep the object alive in Lua.
      */
-    static void Push(lua_State* L, void* const p, void const* const key)
+    static void Push(lua_State* L, void* const p, void const* const key,
+                     ClassRecord const& record, bool isConst)
     {
-        if(p)
+        lua_rawgetp(L, LUA_REGISTRYINDEX, key);
+        // If this goes off it means you forgot to register the class!
+        assert(lua_istable(L, -1));
+        rawgetkey(L, -1, CacheKey);
+        if(lua_istable(L, -1))
         {
-            new(lua_newuserdata(L, sizeof(UserdataPtr))) UserdataPtr(p);
-            lua_rawgetp(L, LUA_REGISTRYINDEX, key);
-            // If this goes off it means you forgot to register the class!
-            assert(lua_istable(L, -1));
-            lua_setmetatable(L, -2);
+            lua_rawgetp(L, -1, p);
+            if(!lua_isnil(L, -1))
+            {
+                lua_replace(L, -3);
+                lua_pop(L, 1);
+                return;
+            }
+            lua_pop(L, 1);
         }
-        else
+        
+        new(luaS_newuserdata(L, sizeof(UserdataPtr), UserValueCount(L, key))) UserdataPtr(p, record, isConst);
+        lua_pushvalue(L, -3);
+        lua_setmetatable(L, -2);
+        if(lua_istable(L, -2))
         {
-            lua_pushnil(L);
+            lua_pushvalue(L, -1);
+            lua_rawsetp(L, -3, p);
         }
+        lua_replace(L, -3);
+        lua_pop(L, 1);
     }
     
-    /** Push const pointer to object using metatable key.
+    /** Remove p from the cache in the metatable of key.
      */
-    static void Push(lua_State* L, void const* const p, void const* const key)
+    static void Forget(lua_State* L, void const* const p, void const* const key)
     {
-        if(p)
+        lua_rawgetp(L, LUA_REGISTRYINDEX, key);
+        if(lua_istable(L, -1))
         {
-            new(lua_newuserdata(L, sizeof(UserdataPtr)))
-            UserdataPtr(const_cast<void*>(p));
-            lua_rawgetp(L, LUA_REGISTRYINDEX, key);
-            // If this goes off it means you forgot to register the class!
-            assert(lua_istable(L, -1));
-            lua_setmetatable(L, -2);
-        }
-        else
-        {
-            lua_pushnil(L);
+            rawgetkey(L, -1, CacheKey);
+            if(lua_istable(L, -1))
+            {
+                lua_pushnil(L);
+                lua_rawsetp(L, -2, p);
+            }
+            lua_pop(L, 1);
         }
+        lua_pop(L, 1);
     }
     
-    explicit UserdataPtr(void* const p)
+    UserdataPtr(void* const p, ClassRecord const& record, bool isConst)
     {
         m_p = p;
+        SetClass(record, isConst);
         
         // Can't construct with a null pointer!
         //
@@ -586,7 +779,7 @@ public:
     static inline void Push(lua_State* const L, T* const p)
     {
         if(p)
-            Push(L, p, ClassInfo<T>::GetClassKey());
+            Push(L, p, ClassInfo<T>::GetClassKey(), ClassInfo<T>::GetRecord(), false);
         else
             lua_pushnil(L);
     }
@@ -597,12 +790,78 @@ public:
     static inline void Push(lua_State* const L, T const* const p)
     {
         if(p)
-            Push(L, p, ClassInfo<T>::GetConstKey());
+            Push(L, const_cast<T*>(p), ClassInfo<T>::GetConstKey(), ClassInfo<T>::GetRecord(), true);
         else
             lua_pushnil(L);
     }
+    
+    /** Drop the cached userdata of an object of a cached class.
+     
+     Call this when the object is destroyed, or a new object allocated at the
+     same address would be pushed as the stale userdata. Both the const and
+     the non-const entry are removed; an object pushed as several classes
+     needs a call for each. Userdata still referenced by scripts keeps the
+     dangling pointer, as with any object pushed by pointer.
+     */
+    template<typename T>
+    static inline void Invalidate(lua_State* const L, T const* const p)
+    {
+        Forget(L, p, ClassInfo<T>::GetClassKey());
+        Forget(L, p, ClassInfo<T>::GetConstKey());
+    }
 };
 
+//============================================================================
+/**
+ Base of the userdata which own a container.
+ 
+ Each derived class passes the function which runs its destructor, the
+ container type is only known there.
+ */
+class UserdataHolder : public Userdata
+{
+    friend class Userdata;
+    
+protected:
+    typedef void (*Finalizer)(UserdataHolder*);
+    
+    UserdataHolder(Finalizer finalize, Storage storage)
+    : m_finalize(finalize)
+    {
+        m_storage = static_cast<unsigned char>(storage);
+    }
+    
+    ~UserdataHolder()
+    {
+    }
+    
+private:
+    UserdataHolder(UserdataHolder const&);
+    UserdataHolder& operator=(UserdataHolder const&);
+    
+    Finalizer m_finalize;
+};
+
+//----------------------------------------------------------------------------
+inline void Userdata::Destroy()
+{
+    switch(m_storage)
+    {
+        case ValueStorage:
+            m_record->Destroy(m_p);
+            break;
+            
+        case ContainerStorage:
+        case SharedOwnerStorage:
+            static_cast<UserdataHolder*>(this)->m_finalize(static_cast<UserdataHolder*>(this));
+            break;
+            
+        default:
+            break;
+    }
+    m_storage = PointerStorage;
+}
+
 //============================================================================
 /**
  Wraps a container thet references a class object.
@@ -611,7 +870,7 @@ public:
  specialized on C or else a compile error will result.
  */
 template<typename C>
-class UserdataShared : public Userdata
+class UserdataShared : public UserdataHolder
 {
 private:
     UserdataShared(UserdataShared<C> const&);
@@ -627,25 +886,228 @@ private:
     {
     }
     
+    static void Finalize(UserdataHolder* ud)
+    {
+        static_cast<UserdataShared<C>*>(ud)->~UserdataShared();
+    }
+    
 public:
     /**
      Construct from a container to the class or a derived class.
      */
     template<typename U>
-    explicit UserdataShared(U const& u) : m_c(u)
+    UserdataShared(U const& u, bool isConst)
+    : UserdataHolder(&Finalize, ContainerStorage)
+    , m_c(u)
     {
         m_p = const_cast<void*>(reinterpret_cast<void const*>(
                                                                  (ContainerTraits<C>::Get(m_c))));
+        SetClass(ClassInfo<T>::GetRecord(), isConst);
     }
     
     /**
      Construct from a pointer to the class or a derived class.
      */
     template<typename U>
-    explicit UserdataShared(U* u) : m_c(u)
+    UserdataShared(U* u, bool isConst)
+    : UserdataHolder(&Finalize, ContainerStorage)
+    , m_c(u)
     {
         m_p = const_cast<void*>(reinterpret_cast<void const*>(
                                                                  (ContainerTraits<C>::Get(m_c))));
+        SetClass(ClassInfo<T>::GetRecord(), isConst);
+    }
+};
+
+//------------------------------------------------------------------------------
+/**
+ Container traits for std::shared_ptr.
+ */
+template<typename T>
+struct ContainerTraits<std::shared_ptr<T> >
+{
+    typedef T Type;
+    
+    static T* Get(std::shared_ptr<T> const& c)
+    {
+        return c.get();
+    }
+};
+
+//============================================================================
+/**
+ Base of the userdata holding a std::shared_ptr.
+ 
+ The owner is kept as a std::shared_ptr<void const>, which shares the control
+ block of the pushed pointer whatever its type, so the shared pointer can be
+ recovered from the userdata without knowing the type it was pushed with.
+ */
+class UserdataSharedOwner : public UserdataHolder
+{
+private:
+    UserdataSharedOwner(UserdataSharedOwner const&);
+    UserdataSharedOwner& operator=(UserdataSharedOwner const&);
+    
+    std::shared_ptr<void const> m_owner;
+    
+protected:
+    UserdataSharedOwner(Finalizer finalize, std::shared_ptr<void const> const& owner,
+                        ClassRecord const& record, bool isConst)
+    : UserdataHolder(finalize, SharedOwnerStorage)
+    , m_owner(owner)
+    {
+        m_p = const_cast<void*>(m_owner.get());
+        SetClass(record, isConst);
+    }
+    
+    ~UserdataSharedOwner()
+    {
+    }
+    
+public:
+    /**
+     Get a std::shared_ptr to the class from the Lua stack.
+     
+     The result shares ownership with the pointer that was pushed, through
+     the aliasing constructor, so it may point to a base of the pushed class
+     and the object is still deleted as the pushed type. An object that Lua
+     does not hold through a std::shared_ptr raises a Lua error, there is no
+     owner to share.
+     */
+    template<typename T>
+    static std::shared_ptr<T> Get(lua_State* L, int index, bool canBeConst)
+    {
+        T* const p = Userdata::Get<typename TypeTraits::RemoveConst<T>::Type>(L, index, canBeConst);
+        if(!p)
+            return std::shared_ptr<T>();
+        
+        Userdata* const ud = GetHeader(L, index);
+        if(ud == 0 || ud->m_storage != SharedOwnerStorage)
+            luaL_argerror(L, index, "object is not held by a std::shared_ptr");
+        return std::shared_ptr<T>(static_cast<UserdataSharedOwner*>(ud)->m_owner, p);
+    }
+};
+
+/**
+ Wraps a std::shared_ptr to a class object.
+ */
+template<typename U>
+class UserdataShared<std::shared_ptr<U> > : public UserdataSharedOwner
+{
+private:
+    typedef typename TypeTraits::RemoveConst<U>::Type T;
+    
+    ~UserdataShared()
+    {
+    }
+    
+    static void Finalize(UserdataHolder* ud)
+    {
+        static_cast<UserdataShared*>(ud)->~UserdataShared();
+    }
+    
+public:
+    /**
+     Construct from a std::shared_ptr to the class or a derived class.
+     */
+    template<typename V>
+    UserdataShared(std::shared_ptr<V> const& v, bool isConst)
+    : UserdataSharedOwner(&Finalize, v, ClassInfo<T>::GetRecord(), isConst)
+    {
+    }
+    
+    /**
+     Construct from a pointer to the class or a derived class, which the
+     new std::shared_ptr takes ownership of.
+     */
+    template<typename V>
+    UserdataShared(V* v, bool isConst)
+    : UserdataSharedOwner(&Finalize, std::shared_ptr<V>(v), ClassInfo<T>::GetRecord(), isConst)
+    {
+    }
+};
+
+//============================================================================
+/**
+ Wraps a std::unique_ptr to a class object.
+ 
+ Lua becomes the only owner of the object, the pointer is moved into the
+ userdata and the object is deleted when the userdata is collected.
+ */
+template<typename U, typename D>
+class UserdataShared<std::unique_ptr<U, D> > : public UserdataHolder
+{
+private:
+    UserdataShared(UserdataShared const&);
+    UserdataShared& operator=(UserdataShared const&);
+    
+    typedef typename TypeTraits::RemoveConst<U>::Type T;
+    
+    std::unique_ptr<U, D> m_c;
+    
+    UserdataShared(std::unique_ptr<U, D>&& c)
+    : UserdataHolder(&Finalize, ContainerStorage)
+    , m_c(std::move(c))
+    {
+        m_p = const_cast<T*>(m_c.get());
+        SetClass(ClassInfo<T>::GetRecord(), TypeTraits::IsConst<U>::value);
+    }
+    
+    ~UserdataShared()
+    {
+    }
+    
+    static void Finalize(UserdataHolder* ud)
+    {
+        static_cast<UserdataShared*>(ud)->~UserdataShared();
+    }
+    
+public:
+    static void Push(lua_State* L, std::unique_ptr<U, D> c)
+    {
+        if(c)
+        {
+            void const* const key = TypeTraits::IsConst<U>::value ?
+                ClassInfo<T>::GetConstKey() : ClassInfo<T>::GetClassKey();
+            new(luaS_newuserdata(L, sizeof(UserdataShared), UserValueCount(L, key))) UserdataShared(std::move(c));
+            lua_rawgetp(L, LUA_REGISTRYINDEX, key);
+            // If this goes off it means the class T is unregistered!
+            assert(lua_istable(L, -1));
+            lua_setmetatable(L, -2);
+        }
+        else
+        {
+            lua_pushnil(L);
+        }
+    }
+};
+
+//----------------------------------------------------------------------------
+/**
+ Get a container from the Lua stack.
+ 
+ Intrusive containers, and those in the style of RefCountedPtr, are made
+ from the raw pointer. A std::shared_ptr shares the owner kept in the
+ userdata instead.
+ */
+template<typename C>
+struct UserdataContainer
+{
+    typedef typename TypeTraits::RemoveConst<
+    typename ContainerTraits<C>::Type>::Type T;
+    
+    static inline C Get(lua_State* L, int index)
+    {
+        return Userdata::Get<T>(L, index, true);
+    }
+};
+
+template<typename U>
+struct UserdataContainer<std::shared_ptr<U> >
+{
+    static inline std::shared_ptr<U> Get(lua_State* L, int index)
+    {
+        return UserdataSharedOwner::Get<U>(L, index, TypeTraits::IsConst<U>::value);
     }
 };
 
@@ -665,7 +1127,7 @@ struct UserdataSharedHelper
     {
         if(ContainerTraits<C>::Get(c) != 0)
         {
-            new(lua_newuserdata(L, sizeof(UserdataShared<C>))) UserdataShared<C>(c);
+            new(luaS_newuserdata(L, sizeof(UserdataShared<C>), Userdata::UserValueCount(L, ClassInfo<T>::GetClassKey()))) UserdataShared<C>(c, false);
             lua_rawgetp(L, LUA_REGISTRYINDEX, ClassInfo<T>::GetClassKey());
             // If this goes off it means the class T is unregistered!
             assert(lua_istable(L, -1));
@@ -681,7 +1143,7 @@ struct UserdataSharedHelper
     {
         if(t)
         {
-            new(lua_newuserdata(L, sizeof(UserdataShared<C>))) UserdataShared<C>(t);
+            new(luaS_newuserdata(L, sizeof(UserdataShared<C>), Userdata::UserValueCount(L, ClassInfo<T>::GetClassKey()))) UserdataShared<C>(t, false);
             lua_rawgetp(L, LUA_REGISTRYINDEX, ClassInfo<T>::GetClassKey());
             // If this goes off it means the class T is unregistered!
             assert(lua_istable(L, -1));
@@ -705,7 +1167,7 @@ struct UserdataSharedHelper<C, true>
     {
         if(ContainerTraits<C>::Get(c) != 0)
         {
-            new(lua_newuserdata(L, sizeof(UserdataShared<C>))) UserdataShared<C>(c);
+            new(luaS_newuserdata(L, sizeof(UserdataShared<C>), Userdata::UserValueCount(L, ClassInfo<T>::GetConstKey()))) UserdataShared<C>(c, true);
             lua_rawgetp(L, LUA_REGISTRYINDEX, ClassInfo<T>::GetConstKey());
             // If this goes off it means the class T is unregistered!
             assert(lua_istable(L, -1));
@@ -721,7 +1183,7 @@ struct UserdataSharedHelper<C, true>
     {
         if(t)
         {
-            new(lua_newuserdata(L, sizeof(UserdataShared<C>))) UserdataShared<C>(t);
+            new(luaS_newuserdata(L, sizeof(UserdataShared<C>), Userdata::UserValueCount(L, ClassInfo<T>::GetConstKey()))) UserdataShared<C>(t, true);
             lua_rawgetp(L, LUA_REGISTRYINDEX, ClassInfo<T>::GetConstKey());
             // If this goes off it means the class T is unregistered!
             assert(lua_istable(L, -1));
@@ -738,10 +1200,11 @@ struct UserdataSharedHelper<C, true>
  Pass by container.
  
  The container controls the object lifetime. Typically this will be a
- lifetime shared by C++ and Lua using a reference count. Because of type
- erasure, containers like std::shared_ptr will not work. Containers must
- either be of the intrusive variety, or in the style of the RefCountedPtr
- type provided by LuaPortal(that uses a global hash table).
+ lifetime shared by C++ and Lua using a reference count. Containers must
+ either be of the intrusive variety, in the style of the RefCountedPtr
+ type provided by LuaPortal(that uses a global hash table), or a
+ std::shared_ptr, whose owner is kept in the userdata(see
+ UserdataSharedOwner).
  */
 template<typename C, bool byContainer>
 struct StackHelper
@@ -757,7 +1220,7 @@ struct StackHelper
     
     static inline C Get(lua_State* L, int index)
     {
-        return Userdata::Get<T>(L, index, true);
+        return UserdataContainer<C>::Get(L, index);
     }
 
     static inline bool CheckType(lua_State* L, int index)
@@ -1063,7 +1526,7 @@ struct RefStackHelper
     
     static return_type Get(lua_State* L, int index)
     {
-        return Userdata::Get<T>(L, index, true);
+        return UserdataContainer<C>::Get(L, index);
     }
 
     static inline bool CheckType(lua_State* L, int index)
@@ -1134,3 +1597,24 @@ struct Stack<T const&>
         return typeid(helper_t::return_type).name();
     }
 };
+
+//------------------------------------------------------------------------------
+/**
+ Lua stack conversions for std::unique_ptr.
+ 
+ Pushing moves the ownership into Lua. There is no Get, Lua cannot give up
+ the object; functions take it as a pointer or a reference instead.
+ */
+template<typename T, typename D>
+struct Stack<std::unique_ptr<T, D> >
+{
+    static inline void Push(lua_State* L, std::unique_ptr<T, D> p)
+    {
+        UserdataShared<std::unique_ptr<T, D> >::Push(L, std::move(p));
+    }
+    
+    static inline const char * RequireType()
+    {
+        return typeid(std::unique_ptr<T, D>).name();
+    }
+};
@@ -3,15 +3,34 @@
 // All #include dependencies are listed here
 // instead of in the individual header files.
 //
+#include<algorithm>
 #include<cassert>
+#include<cstdint>
+#include<cstdio>
+#include<cstring>
+#include<fstream>
+#include<iterator>
+#include<list>
 #include<sstream>
 #include<stdexcept>
 #include<string>
+#include<tuple>
 #include<typeinfo>
+#include<unordered_map>
 #include<functional>
 #include<memory>
+#include<new>
+#include<mutex>
 #include<type_traits>
+#include<utility>
+#include<vector>
 #include <iostream>
+#include <sys/stat.h>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+    #include <string_view>
+    #define LUAPORTAL_HAS_STRING_VIEW
+#endif
 
 #ifdef _WIN32
     #include <windows.h>
@@ -30,6 +49,7 @@ namespace luaportal
 #include "impl/functraits.h"
 #include "impl/callabletraits.h"
 #include "impl/classinfo.h"
+#include "impl/stringref.h"
 #include "impl/userdata.h"
 #include "impl/constructor.h"
 #include "impl/stack.h"
@@ -74,7 +94,11 @@ namespace luaportal
     };
     
 #include "impl/cfunctions.h"
+#include "impl/memberdispatch.h"
 #include "impl/namespace.h"
+#include "impl/snapshot.h"
+#include "impl/allocator.h"
+#include "impl/chunkcache.h"
 #include "impl/luastate.h"
     
     //------------------------------------------------------------------------------
@@ -0,0 +1,480 @@
+#pragma once
+#include<atomic>
+#include<condition_variable>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include "luaportal.h"
+
+namespace luaportal
+{
+    //==============================================================================
+    /**
+     A pool of fully set up LuaState objects shared by worker threads.
+
+     Every state is created by the factory and prepared once by the setup
+     callback(namespace registrations, preloaded scripts). Threads borrow a
+     state through a Lease, which returns it to the pool when destroyed.
+     Checkout of an idle state and return are lock-free: each slot carries an
+     atomic status that threads claim with a compare-and-swap, starting at a
+     slot derived from the thread id so that concurrent workers rarely contend
+     for the same one. States are created one at a time, so setup never runs
+     concurrently with itself, and a thread waiting on a full pool sleeps
+     until a state is returned.
+
+     Between uses a state is reset: its stack is cleared, globals added or
+     replaced by the borrower are restored to what setup left(a shallow
+     restore, tables mutated in place stay mutated) and the reset callback
+     runs. The pool grows on demand up to maxStates and destroys returned
+     states beyond maxIdleStates; Trim() shrinks it explicitly.
+
+     A state is used by one thread at a time, the pool itself may be used
+     from any number of threads.
+
+     e.g. @code
+     LuaStatePool pool([](LuaState& ls) {
+         ls.GlobalContext().BeginClass<Foo>("Foo").EndClass();
+         ls.DoFile("handlers.lua");
+     });
+
+     LuaStatePool::Lease lease = pool.Acquire();
+     lease->GetGlobal("handle")(request);
+     @endcode
+     */
+    class LuaStatePool
+    {
+    public:
+        typedef std::function<void(LuaState&)> SetupFunction;
+        typedef std::function<void(LuaState&)> ResetFunction;
+        typedef std::function<LuaState*()> FactoryFunction;
+
+        struct Options
+        {
+            Options()
+            : initialStates(0)
+            , maxStates(64)
+            , maxIdleStates(64)
+            , restoreGlobals(true)
+            {
+            }
+
+            /** States created by the constructor. */
+            size_t initialStates;
+            /** Upper bound on the number of states alive at once. */
+            size_t maxStates;
+            /** Returned states beyond this number are destroyed. */
+            size_t maxIdleStates;
+            /** Undo changes to the global table between uses. */
+            bool restoreGlobals;
+            /** Creates the states, `new LuaState()` if empty. */
+            FactoryFunction factory;
+            /** Runs on every returned state after the built-in reset. */
+            ResetFunction reset;
+        };
+
+    private:
+        enum SlotStatus
+        {
+            Empty,
+            Idle,
+            Busy
+        };
+
+        struct Slot
+        {
+            Slot()
+            : status(Empty)
+            , state(NULL)
+            {
+            }
+
+            std::atomic<int> status;
+            LuaState* state;
+        };
+
+    public:
+        //--------------------------------------------------------------------------
+        /**
+         Exclusive use of a pooled state, returned to the pool on destruction.
+         */
+        class Lease
+        {
+        public:
+            Lease()
+            : m_pool(NULL)
+            , m_slot(NULL)
+            {
+            }
+
+            Lease(Lease&& other)
+            : m_pool(other.m_pool)
+            , m_slot(other.m_slot)
+            {
+                other.m_pool = NULL;
+                other.m_slot = NULL;
+            }
+
+            Lease& operator=(Lease&& other)
+            {
+                if(this != &other)
+                {
+                    Release();
+                    m_pool = other.m_pool;
+                    m_slot = other.m_slot;
+                    other.m_pool = NULL;
+                    other.m_slot = NULL;
+                }
+                return *this;
+            }
+
+            ~Lease()
+            {
+                Release();
+            }
+
+            /** Return the state to the pool early. */
+            void Release()
+            {
+                if(m_slot != NULL)
+                {
+                    m_pool->Return(m_slot);
+                    m_pool = NULL;
+                    m_slot = NULL;
+                }
+            }
+
+            explicit operator bool() const
+            {
+                return m_slot != NULL;
+            }
+
+            LuaState& operator*() const
+            {
+                assert(m_slot != NULL);
+                return *m_slot->state;
+            }
+
+            LuaState* operator->() const
+            {
+                assert(m_slot != NULL);
+                return m_slot->state;
+            }
+
+            lua_State* GetState() const
+            {
+                assert(m_slot != NULL);
+                return m_slot->state->GetState();
+            }
+
+        private:
+            friend class LuaStatePool;
+
+            Lease(LuaStatePool* pool, Slot* slot)
+            : m_pool(pool)
+            , m_slot(slot)
+            {
+            }
+
+            Lease(Lease const&);
+            Lease& operator=(Lease const&);
+
+            LuaStatePool* m_pool;
+            Slot* m_slot;
+        };
+
+        explicit LuaStatePool(SetupFunction setup, Options const& options = Options())
+        : m_setup(setup)
+        , m_options(options)
+        , m_slots(new Slot [options.maxStates > 0 ? options.maxStates : 1])
+        , m_capacity(options.maxStates > 0 ? options.maxStates : 1)
+        , m_size(0)
+        , m_idle(0)
+        , m_waiters(0)
+        {
+            size_t const initial = options.initialStates< m_capacity ? options.initialStates : m_capacity;
+            for(size_t i = 0; i< initial; ++i)
+            {
+                m_slots [i].state = CreateState();
+                m_slots [i].status.store(Idle, std::memory_order_relaxed);
+                ++m_size;
+                ++m_idle;
+            }
+        }
+
+        /** Destroy all states; no lease may be outstanding. */
+        ~LuaStatePool()
+        {
+            for(size_t i = 0; i< m_capacity; ++i)
+            {
+                assert(m_slots [i].status.load() != Busy);
+                delete m_slots [i].state;
+            }
+        }
+
+        //--------------------------------------------------------------------------
+        /**
+         Borrow a state, creating one if none is idle and the pool may grow.
+         Waits for a state to be returned when the pool is at maxStates.
+         */
+        Lease Acquire()
+        {
+            Slot* slot = AcquireSlot();
+            if(slot == NULL)
+            {
+                std::unique_lock<std::mutex> lock(m_waitMutex);
+                ++m_waiters;
+                // Pairs with the fence in NotifyWaiters: either the returning
+                // thread sees this waiter, or the retry below sees its slot.
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                // Only claim the slot under the lock, a new state is created
+                // after it is released so that returns are not held up.
+                while((slot = ClaimSlot()) == NULL)
+                    m_available.wait(lock);
+                --m_waiters;
+                lock.unlock();
+                PrepareSlot(slot);
+            }
+            return Lease(this, slot);
+        }
+
+        /** Borrow a state without waiting; the lease is empty on failure. */
+        Lease TryAcquire()
+        {
+            return Lease(this, AcquireSlot());
+        }
+
+        //--------------------------------------------------------------------------
+        /**
+         Destroy idle states until at most keepIdle remain.
+
+         @returns The number of states destroyed.
+         */
+        size_t Trim(size_t keepIdle = 0)
+        {
+            size_t destroyed = 0;
+            for(size_t i = 0; i< m_capacity && m_idle.load() > keepIdle; ++i)
+            {
+                Slot& slot = m_slots [i];
+                int expected = Idle;
+                if(slot.status.compare_exchange_strong(expected, Busy, std::memory_order_acquire))
+                {
+                    --m_idle;
+                    Destroy(slot);
+                    ++destroyed;
+                }
+            }
+            return destroyed;
+        }
+
+        /** The number of states alive, borrowed or idle. */
+        size_t Size() const
+        {
+            return m_size.load();
+        }
+
+        /** The number of states waiting in the pool. */
+        size_t IdleCount() const
+        {
+            return m_idle.load();
+        }
+
+    private:
+        static void const* GetGlobalsKey()
+        {
+            static char value;
+            return &value;
+        }
+
+        LuaState* CreateState()
+        {
+            // Setup registers classes and runs scripts, which is not meant to
+            // run on several threads at once.
+            std::lock_guard<std::mutex> lock(m_createMutex);
+            std::unique_ptr<LuaState> ls(m_options.factory ? m_options.factory() : new LuaState());
+            m_setup(*ls);
+
+            if(m_options.restoreGlobals)
+            {
+                // Keep a shallow copy of the globals as setup left them.
+                lua_State* L = ls->GetState();
+                luaS_pushglobaltable(L);
+                lua_newtable(L);
+                lua_pushnil(L);
+                while(lua_next(L, -3))
+                {
+                    lua_pushvalue(L, -2);
+                    lua_insert(L, -2);
+                    lua_rawset(L, -4);
+                }
+                lua_rawsetp(L, LUA_REGISTRYINDEX, GetGlobalsKey());
+                lua_pop(L, 1);
+            }
+            return ls.release();
+        }
+
+        void Destroy(Slot& slot)
+        {
+            delete slot.state;
+            slot.state = NULL;
+            --m_size;
+            slot.status.store(Empty, std::memory_order_release);
+        }
+
+        Slot* AcquireSlot()
+        {
+            Slot* const slot = ClaimSlot();
+            if(slot != NULL)
+                PrepareSlot(slot);
+            return slot;
+        }
+
+        /**
+         Mark an idle or empty slot busy. The state of an empty slot is still
+         NULL, PrepareSlot() creates it.
+         */
+        Slot* ClaimSlot()
+        {
+            size_t const start = std::hash<std::thread::id>()(std::this_thread::get_id()) % m_capacity;
+
+            if(m_idle.load(std::memory_order_relaxed) > 0)
+            {
+                for(size_t i = 0; i< m_capacity; ++i)
+                {
+                    Slot& slot = m_slots [(start + i) % m_capacity];
+                    int expected = Idle;
+                    if(slot.status.load(std::memory_order_relaxed) == Idle &&
+                       slot.status.compare_exchange_strong(expected, Busy, std::memory_order_acquire))
+                    {
+                        --m_idle;
+                        return &slot;
+                    }
+                }
+            }
+
+            for(size_t i = 0; i< m_capacity; ++i)
+            {
+                Slot& slot = m_slots [(start + i) % m_capacity];
+                int expected = Empty;
+                if(slot.status.load(std::memory_order_relaxed) == Empty &&
+                   slot.status.compare_exchange_strong(expected, Busy, std::memory_order_acquire))
+                {
+                    return &slot;
+                }
+            }
+            return NULL;
+        }
+
+        /** Create the state of a slot claimed while empty. */
+        void PrepareSlot(Slot* slot)
+        {
+            if(slot->state != NULL)
+                return;
+
+            try
+            {
+                slot->state = CreateState();
+            }
+            catch(...)
+            {
+                slot->status.store(Empty, std::memory_order_release);
+                NotifyWaiters();
+                throw;
+            }
+            ++m_size;
+        }
+
+        void Return(Slot* slot)
+        {
+            Reset(*slot->state);
+
+            // Claim a place among the idle states, so that concurrent returns
+            // never keep more than maxIdleStates.
+            size_t idle = m_idle.load(std::memory_order_relaxed);
+            do
+            {
+                if(idle >= m_options.maxIdleStates)
+                {
+                    Destroy(*slot);
+                    NotifyWaiters();
+                    return;
+                }
+            }
+            while(!m_idle.compare_exchange_weak(idle, idle + 1, std::memory_order_relaxed));
+
+            slot->status.store(Idle, std::memory_order_release);
+            NotifyWaiters();
+        }
+
+        /** Wake a thread blocked in Acquire(), if any. */
+        void NotifyWaiters()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(m_waiters.load(std::memory_order_relaxed) == 0)
+                return;
+            {
+                // The waiter checks the slots while holding the mutex, taking it
+                // here keeps the notification from falling between its check
+                // and its wait.
+                std::lock_guard<std::mutex> lock(m_waitMutex);
+            }
+            m_available.notify_one();
+        }
+
+        void Reset(LuaState& ls)
+        {
+            lua_State* L = ls.GetState();
+            lua_settop(L, 0);
+
+            if(m_options.restoreGlobals)
+            {
+                luaS_pushglobaltable(L);
+                lua_rawgetp(L, LUA_REGISTRYINDEX, GetGlobalsKey());
+
+                // Clear globals that setup did not define; assigning nil to an
+                // existing field is allowed during traversal.
+                lua_pushnil(L);
+                while(lua_next(L, 1))
+                {
+                    lua_pop(L, 1);
+                    lua_pushvalue(L, -1);
+                    lua_rawget(L, 2);
+                    bool const added = lua_isnil(L, -1);
+                    lua_pop(L, 1);
+                    if(added)
+                    {
+                        lua_pushvalue(L, -1);
+                        lua_pushnil(L);
+                        lua_rawset(L, 1);
+                    }
+                }
+
+                lua_pushnil(L);
+                while(lua_next(L, 2))
+                {
+                    lua_pushvalue(L, -2);
+                    lua_insert(L, -2);
+                    lua_rawset(L, 1);
+                }
+                lua_settop(L, 0);
+            }
+
+            if(m_options.reset)
+                m_options.reset(ls);
+        }
+
+        LuaStatePool(LuaStatePool const&);
+        LuaStatePool& operator=(LuaStatePool const&);
+
+        SetupFunction const m_setup;
+        Options const m_options;
+        std::unique_ptr<Slot []> const m_slots;
+        size_t const m_capacity;
+        std::atomic<size_t> m_size;
+        std::atomic<size_t> m_idle;
+        std::atomic<size_t> m_waiters;
+        std::mutex m_createMutex;
+        std::mutex m_waitMutex;
+        std::condition_variable m_available;
+    };
+}
@@ -1,5 +1,54 @@
 #pragma once
+#include<atomic>
 #include<cassert>
+#include "atomicrefcount.h"
+
+//==============================================================================
+/**
+ Operations on the counter of a RefCountedObjectType.
+ 
+ Plain integers use the built-in operators.
+ */
+template<typename CounterType>
+struct RefCountTraits
+{
+    static void Increment(CounterType& count)
+    {
+        ++count;
+    }
+    
+    /** Returns true when the last reference went away. */
+    static bool Decrement(CounterType& count)
+    {
+        return --count == 0;
+    }
+    
+    static int Get(CounterType const& count)
+    {
+        return static_cast<int>(count);
+    }
+};
+
+/** Atomic counters for objects shared between threads(see AtomicRefCount).
+ */
+template<typename T>
+struct RefCountTraits<std::atomic<T> >
+{
+    static void Increment(std::atomic<T>& count)
+    {
+        AtomicRefCount::Increment(count);
+    }
+    
+    static bool Decrement(std::atomic<T>& count)
+    {
+        return AtomicRefCount::Decrement(count);
+    }
+    
+    static int Get(std::atomic<T> const& count)
+    {
+        return static_cast<int>(AtomicRefCount::Get(count));
+    }
+};
 
 //==============================================================================
 /**
@@ -39,7 +88,7 @@ public:
      */
     inline void incReferenceCount() const
     {
-        ++refCount;
+        RefCountTraits<CounterType>::Increment(refCount);
     }
     
     /** Decreases the object's reference count.
@@ -50,14 +99,14 @@ public:
     {
         assert(getReferenceCount() > 0);
         
-        if(--refCount == 0)
+        if(RefCountTraits<CounterType>::Decrement(refCount))
             delete this;
     }
     
     /** Returns the object's current reference count. */
     inline int getReferenceCount() const
     {
-        return static_cast<int>(refCount);
+        return RefCountTraits<CounterType>::Get(refCount);
     }
     
 protected:
@@ -67,6 +116,19 @@ protected:
     {
     }
     
+    /** Copying the object does not copy its references, the copy starts with
+     a ref count of zero. This also keeps atomic counters copyable.
+     */
+    RefCountedObjectType(RefCountedObjectType const&) : refCount()
+    {
+    }
+    
+    /** Assignment leaves the ref count of the target alone. */
+    RefCountedObjectType& operator=(RefCountedObjectType const&)
+    {
+        return *this;
+    }
+    
     /** Destructor. */
     virtual ~RefCountedObjectType()
     {
@@ -88,6 +150,14 @@ private:
  */
 typedef RefCountedObjectType<int> RefCountedObject;
 
+/** Thread-safe reference counted object.
+ 
+ This creates a RefCountedObjectType that uses an atomic integer as the
+ counter, for objects referenced from several threads. It works with
+ RefCountedObjectPtr(and therefore with Lua) like RefCountedObject.
+ */
+typedef RefCountedObjectType<std::atomic<int> > AtomicRefCountedObject;
+
 //==============================================================================
 /**
  A smart-pointer class which points to a reference-counted object.
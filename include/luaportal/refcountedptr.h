@@ -1,5 +1,10 @@
 #pragma once
+#include<atomic>
+#include<cstdint>
+#include<mutex>
 #include<unordered_map>
+#include<utility>
+#include "atomicrefcount.h"
 
 //==============================================================================
 /**
@@ -11,13 +16,155 @@ struct RefCountedPtrBase
     typedef std::unordered_map<const void *, int> RefCountsType;
     
 protected:
-    inline RefCountsType& getRefCounts()
+    static inline RefCountsType& getRefCounts()
     {
         static RefCountsType refcounts;
         return refcounts ;
     }
 };
 
+//==============================================================================
+/**
+ Reference count policies of RefCountedPtr.
+ 
+ A policy provides Increment(p), Decrement(p), which returns true when the
+ last reference went away and the object must be deleted, and Count(p).
+ */
+
+/**
+ The reference counts live in one process-wide hash table.
+ 
+ This is the original behavior and the default. It works with any type but
+ is not thread-safe: all RefCountedPtr objects using it must be copied and
+ destroyed on one thread.
+ */
+struct GlobalTableRefCount : private RefCountedPtrBase
+{
+    static void Increment(void const* p)
+    {
+        ++getRefCounts() [p];
+    }
+    
+    static bool Decrement(void const* p)
+    {
+        RefCountsType::iterator const it = getRefCounts().find(p);
+        if(--it->second > 0)
+            return false;
+        getRefCounts().erase(it);
+        return true;
+    }
+    
+    static long Count(void const* p)
+    {
+        RefCountsType::const_iterator const it = getRefCounts().find(p);
+        return it != getRefCounts().end() ? it->second : 0;
+    }
+};
+
+/**
+ The reference counts live in a hash table split into independently locked
+ shards, chosen by the address of the object.
+ 
+ Thread-safe and still non-intrusive. Threads counting different objects
+ rarely contend for the same shard; counting the same object serializes on
+ its shard.
+ */
+struct ShardedRefCount
+{
+    static void Increment(void const* p)
+    {
+        Shard& shard = GetShard(p);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ++shard.counts [p];
+    }
+    
+    static bool Decrement(void const* p)
+    {
+        Shard& shard = GetShard(p);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        std::unordered_map<void const*, long>::iterator const it = shard.counts.find(p);
+        if(--it->second > 0)
+            return false;
+        shard.counts.erase(it);
+        return true;
+    }
+    
+    static long Count(void const* p)
+    {
+        Shard& shard = GetShard(p);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        std::unordered_map<void const*, long>::const_iterator const it = shard.counts.find(p);
+        return it != shard.counts.end() ? it->second : 0;
+    }
+    
+private:
+    static size_t const shardCount = 64;
+    
+    // Each shard on its own cache line.
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<void const*, long> counts;
+    };
+    
+    static Shard& GetShard(void const* p)
+    {
+        static Shard shards [shardCount];
+        uintptr_t const address = reinterpret_cast<uintptr_t>(p);
+        return shards [((address >> 4) ^ (address >> 12)) % shardCount];
+    }
+};
+
+/**
+ Base class for objects counted with AtomicIntrusiveRefCount.
+ 
+ The count is stored in the object, copies of the object start with a count
+ of zero.
+ */
+class IntrusiveRefCount
+{
+protected:
+    IntrusiveRefCount() : m_refCount(0)
+    {
+    }
+    
+    IntrusiveRefCount(IntrusiveRefCount const&) : m_refCount(0)
+    {
+    }
+    
+    IntrusiveRefCount& operator=(IntrusiveRefCount const&)
+    {
+        return *this;
+    }
+    
+private:
+    friend struct AtomicIntrusiveRefCount;
+    
+    mutable std::atomic<long> m_refCount;
+};
+
+/**
+ Lock-free reference counting with the count inside the object, which must
+ derive from IntrusiveRefCount(see AtomicRefCount).
+ */
+struct AtomicIntrusiveRefCount
+{
+    static void Increment(IntrusiveRefCount const* p)
+    {
+        AtomicRefCount::Increment(p->m_refCount);
+    }
+    
+    static bool Decrement(IntrusiveRefCount const* p)
+    {
+        return AtomicRefCount::Decrement(p->m_refCount);
+    }
+    
+    static long Count(IntrusiveRefCount const* p)
+    {
+        return AtomicRefCount::Get(p->m_refCount);
+    }
+};
+
 //==============================================================================
 /**
  A reference counted smart pointer.
@@ -25,26 +172,29 @@ protected:
  The api is compatible with boost::RefCountedPtr and std::RefCountedPtr, in the
  sense that it implements a strict subset of the functionality.
  
- This implementation uses a hash table to look up the reference count
- associated with a particular pointer.
+ The reference count is kept by the CountPolicy. The default looks it up in
+ a process-wide hash table(see GlobalTableRefCount); ShardedRefCount and
+ AtomicIntrusiveRefCount may be used from several threads at once.
  
- @tparam T The class type.
+ e.g. @code
+ class Mesh : public IntrusiveRefCount { ... };
+ typedef RefCountedPtr<Mesh, AtomicIntrusiveRefCount> MeshPtr;
+ @endcode
  
- @todo Decompose RefCountedPtr using a policy. At a minimum, the underlying
- reference count should be policy based(to support atomic operations)
- and the delete behavior should be policy based(to support custom
- disposal methods).
+ @tparam T           The class type.
+ @tparam CountPolicy The reference count policy.
  
- @todo Provide an intrusive version of RefCountedPtr.
+ @todo The delete behavior should be policy based(to support custom
+ disposal methods).
  */
-template<typename T>
-class RefCountedPtr : private RefCountedPtrBase
+template<typename T, typename CountPolicy = GlobalTableRefCount>
+class RefCountedPtr
 {
 public:
     template<typename Other>
     struct rebind
     {
-        typedef RefCountedPtr<Other> other;
+        typedef RefCountedPtr<Other, CountPolicy> other;
     };
     
     /** Construct as nullptr or from existing pointer to T.
@@ -53,16 +203,25 @@ public:
      */
     RefCountedPtr(T* p = 0) : m_p(p)
     {
-        ++getRefCounts() [m_p];
+        acquire();
     }
     
     /** Construct from another RefCountedPtr.
      
      @param rhs The RefCountedPtr to assign from.
      */
-    RefCountedPtr(RefCountedPtr<T> const& rhs) : m_p(rhs.Get())
+    RefCountedPtr(RefCountedPtr const& rhs) : m_p(rhs.Get())
+    {
+        acquire();
+    }
+    
+    /** Take over the reference of another RefCountedPtr.
+     
+     @param rhs The RefCountedPtr to move from, null afterwards.
+     */
+    RefCountedPtr(RefCountedPtr&& rhs) : m_p(rhs.m_p)
     {
-        ++getRefCounts() [m_p];
+        rhs.m_p = 0;
     }
     
     /** Construct from a RefCountedPtr of a different type.
@@ -73,9 +232,9 @@ public:
      @tparam U   The other object type.
      */
     template<typename U>
-    RefCountedPtr(RefCountedPtr<U> const& rhs) : m_p(static_cast<T*>(rhs.Get()))
+    RefCountedPtr(RefCountedPtr<U, CountPolicy> const& rhs) : m_p(static_cast<T*>(rhs.Get()))
     {
-        ++getRefCounts() [m_p];
+        acquire();
     }
     
     /** Release the object.
@@ -92,14 +251,24 @@ public:
      @param  rhs The RefCountedPtr to assign from.
      @return     A reference to the RefCountedPtr.
      */
-    RefCountedPtr<T>& operator=(RefCountedPtr<T> const& rhs)
+    RefCountedPtr& operator=(RefCountedPtr const& rhs)
     {
-        if(m_p != rhs.m_p)
-        {
-            reset();
-            m_p = rhs.m_p;
-            ++getRefCounts() [m_p];
-        }
+        // Take the new reference before the old one goes, the old object
+        // may own rhs.
+        RefCountedPtr copy(rhs);
+        std::swap(m_p, copy.m_p);
+        return *this;
+    }
+    
+    /** Take over the reference of another RefCountedPtr.
+     
+     @param  rhs The RefCountedPtr to move from.
+     @return     A reference to the RefCountedPtr.
+     */
+    RefCountedPtr& operator=(RefCountedPtr&& rhs)
+    {
+        RefCountedPtr moved(std::move(rhs));
+        std::swap(m_p, moved.m_p);
         return *this;
     }
     
@@ -112,11 +281,13 @@ public:
      @return     A reference to the RefCountedPtr.
      */
     template<typename U>
-    RefCountedPtr<T>& operator=(RefCountedPtr<U> const& rhs)
+    RefCountedPtr& operator=(RefCountedPtr<U, CountPolicy> const& rhs)
     {
+        T* const p = static_cast<T*>(rhs.Get());
+        if(p != 0)
+            CountPolicy::Increment(p);
         reset();
-        m_p = static_cast<T*>(rhs.Get());
-        ++getRefCounts() [m_p];
+        m_p = p;
         return *this;
     }
     
@@ -149,13 +320,14 @@ public:
     
     /** Determine the number of references.
      
-     @note This is not thread-safe.
+     @note With a thread-safe policy the result may be stale by the time it
+     is returned.
      
-     @return The number of active references.
+     @return The number of active references, 0 for a null pointer.
      */
     long use_count() const
     {
-        return getRefCounts() [m_p];
+        return m_p != 0 ? CountPolicy::Count(m_p) : 0;
     }
     
     /** Release the pointer.
@@ -167,14 +339,20 @@ public:
     {
         if(m_p != 0)
         {
-            if(--getRefCounts() [m_p]<= 0)
-                delete m_p;
-            
+            T* const p = m_p;
             m_p = 0;
+            if(CountPolicy::Decrement(p))
+                delete p;
         }
     }
     
 private:
+    void acquire()
+    {
+        if(m_p != 0)
+            CountPolicy::Increment(m_p);
+    }
+    
     T* m_p;
 };
 
@@ -187,12 +365,12 @@ namespace luaportal
     template<typename T>
     struct ContainerTraits;
     
-    template<typename T>
-    struct ContainerTraits<RefCountedPtr<T> >
+    template<typename T, typename CountPolicy>
+    struct ContainerTraits<RefCountedPtr<T, CountPolicy> >
     {
         typedef T Type;
         
-        static T* Get(RefCountedPtr<T> const& c)
+        static T* Get(RefCountedPtr<T, CountPolicy> const& c)
         {
             return c.Get();
         }
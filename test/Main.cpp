@@ -1,6 +1,8 @@
 #include <iostream>
+#include <thread>
 #include <lua.hpp>
 #include <luaportal/luaportal.h>
+#include <luaportal/luastatepool.h>
 #include <luaportal/refcountedobject.h>
 #include <luaportal/refcountedptr.h>
 using namespace luaportal;
@@ -47,6 +49,11 @@ private:
     int id_;
 };
 
+class D : public B {
+public:
+    int level = 3;
+};
+
 enum class TestEnum {
     Value1,
     Value2
@@ -56,17 +63,44 @@ struct C : RefCountedObject{
 
 };
 
+struct AtomicC : AtomicRefCountedObject{
+
+};
+
+struct Counter {
+    int count = 0;
+    int limit = 0;
+    void Add(int n) { count += n; }
+    int Get() const { return count; }
+    int GetTwice() const { return count * 2; }
+    void SetTwice(int v) { count = v / 2; }
+};
+
+constexpr MemberEntry counterMembers[] = {
+    LUAPORTAL_FIELD(Counter, count),
+    LUAPORTAL_METHOD(Counter, Add),
+    LUAPORTAL_METHOD(Counter, Get),
+    LUAPORTAL_PROPERTY(Counter, "twice", GetTwice, SetTwice),
+};
+
+int Subtract(int a, int b)
+{
+    return a - b;
+}
+
 void TestNamespace(LuaState& ls)
 {
     ls.GlobalContext()
         .BeginNamespace("test")
         .BeginClass <A>("A")
         .Def(Constructor<>())
+        .Extensible()
         .AddData("name", &A::name)
         .AddFunction("print", &A::Print)
         .EndClass()
         .DeriveClass <B, A>("B")
         .Def(Constructor<>())
+        .CachePointers()
         .AddData("TestSTDFunction", &B::TestSTDFunction)
         .AddProperty("id", &B::GetID, &B::SetID)
         .AddProperty("readonlyid", &B::GetID)
@@ -75,6 +109,12 @@ void TestNamespace(LuaState& ls)
         .AddLambda("lambdatest1", [](B* B) {if (B != nullptr) { B->name = "newname"; }})
         .AddStaticLambda("lambdatest2", []()->std::string { return "B.lambdatest2()"; })
         .EndClass()
+        .DeriveClass <D, B>("D")
+        .Def(Constructor<>())
+        .UseDirectAccessors()
+        .AddData("level", &D::level)
+        .Seal()
+        .EndClass()
         .AddLambda("lambdatest3", []()->B* { return B::GetInstance(); })
         .EndNamespace()
         .BeginEnum<TestEnum>("TestEnum")
@@ -93,6 +133,55 @@ void TestNamespace(LuaState& ls)
     ls.DoString("b:RiseID() print('b.readonlyid = ',b.readonlyid) b.readonlyid = 456789");
     assert(ls.GetGlobal("test")["B"]["lambdatest2"]().Cast<std::string>() == "B.lambdatest2()");
     assert(ls.GetGlobal("test")["lambdatest3"]().Cast<B*>() == B::GetInstance());
+    ls.DoString("same = b == test.B.GetInstance() and b == test.lambdatest3()");
+    assert(ls.GetGlobal("same").Cast<bool>());
+    UserdataPtr::Invalidate(ls.GetState(), B::GetInstance());
+    ls.DoString("same = b == test.B.GetInstance()");
+    assert(!ls.GetGlobal("same").Cast<bool>());
+
+    ls.DoString("d = test.D() d.name = 'sealed' d.id = 7 d:RiseID() d:Print()");
+    assert(ls.GetGlobal("d").Cast<D*>()->GetID() == 8);
+    assert(ls.GetGlobal("d")["name"].Cast<std::string>() == "sealed");
+    assert(ls.GetGlobal("d")["level"].Cast<int>() == 3);
+    ls.DoString("d.level = d.level + 1");
+    assert(ls.GetGlobal("d").Cast<D*>()->level == 4);
+    ls.DoString("d.note = 'extended' note = d.note other = test.D().note");
+    assert(ls.GetGlobal("note").Cast<std::string>() == "extended");
+    assert(ls.GetGlobal("other").IsNil());
+    {
+        // Extensible() and CachePointers() only apply to the state they were
+        // registered in.
+        LuaState closed;
+        closed.GlobalContext()
+            .BeginNamespace("test")
+            .BeginClass <A>("A")
+            .Def(Constructor<>())
+            .EndClass()
+            .DeriveClass <B, A>("B")
+            .AddStaticFunction("GetInstance", &B::GetInstance)
+            .EndClass()
+            .EndNamespace();
+        closed.DoString("ok = pcall(function() test.A().note = 1 end)");
+        assert(!closed.GetGlobal("ok").Cast<bool>());
+        closed.DoString("same = test.B.GetInstance() == test.B.GetInstance()");
+        assert(!closed.GetGlobal("same").Cast<bool>());
+    }
+    assert(ls.GetGlobal("d")["readonlyid"].Cast<int>() == 8);
+
+    // Arguments are read from the stack in order, so the first bad one is
+    // the one reported.
+    ls.GlobalContext()
+        .BeginNamespace("test")
+        .AddFunction("Subtract", &Subtract)
+        .AddLambda("Divide", [](int a, int b) { return a / b; })
+        .EndNamespace();
+    ls.DoString("diff = test.Subtract(5, 3) quot = test.Divide(6, 3)");
+    assert(ls.GetGlobal("diff").Cast<int>() == 2);
+    assert(ls.GetGlobal("quot").Cast<int>() == 2);
+    ls.DoString("ok, msg = pcall(test.Subtract, 'x', 'y')");
+    assert(ls.GetGlobal("msg").Cast<std::string>().find("#1") != std::string::npos);
+    ls.DoString("ok, msg = pcall(test.Divide, 'x', 'y')");
+    assert(ls.GetGlobal("msg").Cast<std::string>().find("#1") != std::string::npos);
 
     ls.DoString("b.TestSTDFunction = function(a, b) return tostring(a) .. '&' .. tostring(b) end");
     assert(B::GetInstance()->TestSTDFunction(7, 8) == "7&8");
@@ -108,7 +197,25 @@ void TestNamespace(LuaState& ls)
     assert(tb["c"]["d"].Cast<int>() == 3);
     assert(tb["c"]["e"].Cast<std::string>() == "f");
 
-    std::function<void(LuaRef&, int)> TestIterator = [&](LuaRef& tableRef, int level)
+    int const top = lua_gettop(ls.GetState());
+    assert(StackRef::GetGlobal(ls.GetState(), "tb")["c"]["g"]["h"].Cast<int>() == 4);
+    {
+        TableView c = TableView(tb)["c"];
+        assert(c["e"].Cast<std::string>() == "f");
+        assert(c.ToLuaRef()["d"].Cast<int>() == 3);
+    }
+    assert(lua_gettop(ls.GetState()) == top);
+
+    LuaRef r(ls.GetState(), 1);
+    r = 2;
+    LuaRef moved(std::move(r));
+    assert(r.IsNil() && moved.Cast<int>() == 2);
+    r.Swap(moved);
+    assert(r.Cast<int>() == 2 && moved.IsNil());
+    r.Reset();
+    assert(r.IsNil());
+
+    std::function<void(LuaRef const&, int)> TestIterator = [&](LuaRef const& tableRef, int level)
     {
         for (auto itr = Iterator(tableRef); !itr.IsNil(); ++itr)
         {
@@ -130,6 +237,24 @@ void TestNamespace(LuaState& ls)
 
     TestIterator(tb, 0);
 
+    int entries = 0;
+    for (auto const& entry : Pairs(LuaRef(tb["c"])))
+    {
+        if (entry.Key<std::string>() == "d")
+            assert(entry.Value<int>() == 3);
+        ++entries;
+    }
+    assert(entries == 3);
+
+    ls.DoString("arr = { 1, 2, 3, 4 }");
+    int sum = 0;
+    for (auto const& element : IPairs(ls.GetGlobal("arr")))
+    {
+        sum += element.Index() * element.Value<int>();
+    }
+    assert(sum == 30);
+    assert(lua_gettop(ls.GetState()) == top);
+
     ls.DoString("function func() return test.B.GetInstance() end ");
     ls.DoString("function func2(a, b) return a*b end ");
     auto func = ls.GetGlobal("func");
@@ -143,6 +268,23 @@ void TestNamespace(LuaState& ls)
     ls.DoString("function func3() error('error') end");
     ls.GetGlobal("func3")()()();
 
+    ls.EnableChunkCache();
+    ls.DoString("cached = (cached or 0) + 1");
+    ls.DoString("cached = (cached or 0) + 1");
+    assert(ls.GetGlobal("cached").Cast<int>() == 2);
+    assert(ls.GetChunkCache()->GetStats().hits == 1);
+    assert(ls.GetChunkCache()->GetStats().misses == 1);
+    ls.GetChunkCache()->SetMaxStrings(2);
+    ls.DoString("cached = 1");
+    ls.DoString("cached = 2");
+    ls.DoString("cached = (cached or 0) + 1");
+    assert(ls.GetChunkCache()->Size() == 2);
+    assert(ls.GetChunkCache()->GetStats().evictions == 2);
+    ls.DoString("cached = 2");
+    assert(ls.GetChunkCache()->GetStats().hits == 2);
+    ls.DisableChunkCache();
+    assert(lua_gettop(ls.GetState()) == top);
+
 
     // Should clear registed std::function before luastate closed. 
     B::GetInstance()->TestSTDFunction = nullptr;
@@ -213,6 +355,15 @@ void TestStack(LuaState& ls)
     TEST_TYPE_CHECK_DEFAULT(std::string);
     lua_pop(L, 1);
 
+    ss = std::string("binary\0data", 11);
+    Push(L, ss);
+    TEST_TYPE_CHECK_DEFAULT(StringRef);
+    TEST_TYPE_CHECK_DEFAULT(ByteSpan);
+    assert(Stack<StringRef>::Get(L, -1) == StringRef(ss));
+    assert(Stack<ByteSpan>::Get(L, -1).size() == 11);
+    assert(Stack<StringRef>::Get(L, -1).data() == lua_tostring(L, -1));
+    lua_pop(L, 1);
+
     A a;
     A const ac(a);
 
@@ -274,6 +425,8 @@ void TestStack(LuaState& ls)
     TEST_TYPE_CHECK_DEFAULT(char);
     TEST_TYPE_CHECK_DEFAULT(const char*);
     TEST_TYPE_CHECK_DEFAULT(std::string);
+    TEST_TYPE_CHECK_DEFAULT(StringRef);
+    TEST_TYPE_CHECK_DEFAULT(ByteSpan);
     TEST_TYPE_CHECK_DEFAULT(A*);
     TEST_TYPE_CHECK_DEFAULT(A const*);
     TEST_TYPE_CHECK_DEFAULT(A&);
@@ -286,12 +439,260 @@ void TestStack(LuaState& ls)
     lua_settop(L, idx);
 }
 
+struct Node : IntrusiveRefCount {
+    int value = 0;
+    RefCountedPtr<Node, AtomicIntrusiveRefCount> next;
+};
+
+void TestRefCountedPtr()
+{
+    RefCountedPtr<int> global(new int(1));
+    RefCountedPtr<int> globalCopy = global;
+    assert(global.use_count() == 2);
+
+    RefCountedPtr<int, ShardedRefCount> sharded(new int(2));
+    RefCountedPtr<int, ShardedRefCount> shardedCopy(sharded.Get());
+    assert(sharded.use_count() == 2);
+    shardedCopy.reset();
+    assert(sharded.use_count() == 1);
+
+    RefCountedPtr<Node, AtomicIntrusiveRefCount> node(new Node());
+    RefCountedPtr<Node, AtomicIntrusiveRefCount> moved(std::move(node));
+    assert(node.Get() == nullptr && moved.use_count() == 1);
+
+    // The old object owns the right hand side of the assignment.
+    moved->next = RefCountedPtr<Node, AtomicIntrusiveRefCount>(new Node());
+    moved->next->value = 2;
+    moved->next->next = RefCountedPtr<Node, AtomicIntrusiveRefCount>(new Node());
+    moved->next->next->value = 3;
+    moved = moved->next;
+    assert(moved->value == 2 && moved.use_count() == 1);
+    moved = std::move(moved->next);
+    assert(moved->value == 3 && moved.use_count() == 1);
+
+    RefCountedObjectPtr<AtomicC> atomic(new AtomicC());
+    RefCountedObjectPtr<AtomicC> atomicCopy(atomic);
+    assert(atomic->getReferenceCount() == 2);
+    AtomicC copied(*atomic);
+    assert(copied.getReferenceCount() == 0);
+    copied = *atomic;
+    assert(copied.getReferenceCount() == 0 && atomic->getReferenceCount() == 2);
+}
+
+void TestStatePool()
+{
+    LuaStatePool::Options options;
+    options.initialStates = 1;
+    options.maxStates = 2;
+    LuaStatePool pool([](LuaState& ls) { ls.DoString("base = 1"); }, options);
+    assert(pool.Size() == 1);
+    {
+        LuaStatePool::Lease first = pool.Acquire();
+        LuaStatePool::Lease second = pool.TryAcquire();
+        assert(first && second && pool.Size() == 2);
+        assert(!pool.TryAcquire());
+        first->DoString("base = 2 extra = 3");
+    }
+    assert(pool.IdleCount() == 2);
+    for (int i = 0; i < 2; ++i)
+    {
+        LuaStatePool::Lease lease = pool.Acquire();
+        assert(lease->GetGlobal("base").Cast<int>() == 1);
+        assert(lease->GetGlobal("extra").IsNil());
+    }
+    {
+        // A full pool blocks Acquire() until a lease is released.
+        LuaStatePool::Lease first = pool.Acquire();
+        LuaStatePool::Lease second = pool.Acquire();
+        std::thread waiter([&pool] {
+            LuaStatePool::Lease third = pool.Acquire();
+            assert(third);
+        });
+        first.Release();
+        waiter.join();
+    }
+    assert(pool.IdleCount() == 2);
+    assert(pool.Trim(1) == 1 && pool.Size() == 1);
+}
+
+void TestSnapshot()
+{
+    RegistrationSnapshot const snapshot = RegistrationSnapshot::Capture([](lua_State* L) {
+        GetGlobalNamespace(L)
+            .BeginNamespace("snap")
+            .BeginClass <A>("A")
+            .Def(Constructor<>())
+            .AddData("name", &A::name)
+            .AddFunction("print", &A::Print)
+            .EndClass()
+            .EndNamespace();
+    });
+    assert(snapshot.GetObjectCount() > 0);
+
+    LuaState clone;
+    snapshot.Apply(clone.GetState());
+    clone.DoString("local a = snap.A() a.name = 'cloned' a:print() name = a.name");
+    assert(clone.GetGlobal("name").Cast<std::string>() == "cloned");
+}
+
+void TestMemberDispatch(LuaState& ls)
+{
+    ls.GlobalContext()
+        .BeginNamespace("test")
+        .BeginClass <Counter>("Counter")
+        .Def(Constructor<>())
+        .AddMembers(counterMembers)
+        .AddFunction("Reset", &Counter::SetTwice)
+        .EndClass()
+        .EndNamespace();
+
+    ls.DoString("c = test.Counter() c:Add(3) c.count = c.count + 1 c.twice = c:Get() * 4");
+    assert(ls.GetGlobal("c").Cast<Counter*>()->count == 8);
+    assert(ls.GetGlobal("c")["twice"].Cast<int>() == 16);
+    ls.DoString("c:Reset(2)");
+    assert(ls.GetGlobal("c").Cast<Counter*>()->Get() == 1);
+
+    // Members from AddMembers() can still be replaced.
+    ls.GlobalContext()
+        .BeginNamespace("test")
+        .BeginClass <Counter>("Counter")
+        .AddFunction("Add", &Counter::SetTwice)
+        .AddData("count", &Counter::limit)
+        .EndClass()
+        .EndNamespace();
+    ls.DoString("c:Add(10) c.count = 9 n = c.count twice = c.twice");
+    assert(ls.GetGlobal("c").Cast<Counter*>()->count == 5);
+    assert(ls.GetGlobal("c").Cast<Counter*>()->limit == 9);
+    assert(ls.GetGlobal("n").Cast<int>() == 9);
+    assert(ls.GetGlobal("twice").Cast<int>() == 10);
+}
+
+struct FlagDeleter {
+    bool* deleted;
+    void operator()(Counter* c) const { *deleted = true; delete c; }
+};
+
+void TestSmartPointers(LuaState& ls)
+{
+    std::shared_ptr<D> shared = std::make_shared<D>();
+    ls.SetGlobal("shared", shared);
+    assert(shared.use_count() == 2);
+    std::shared_ptr<A> base = ls.GetGlobal("shared").Cast<std::shared_ptr<A>>();
+    assert(base.get() == shared.get() && shared.use_count() == 3);
+
+    bool deleted = false;
+    ls.SetGlobal("unique", std::unique_ptr<Counter, FlagDeleter>(new Counter(), FlagDeleter{ &deleted }));
+    ls.DoString("unique:Add(shared.level) shared = nil unique = nil");
+    lua_gc(ls.GetState(), LUA_GCCOLLECT, 0);
+    assert(deleted && shared.use_count() == 2);
+}
+
+struct alignas(64) Aligned {
+    static int alive;
+    float v[4];
+    Aligned() { ++alive; }
+    Aligned(Aligned const&) { ++alive; }
+    ~Aligned() { --alive; }
+    bool IsAligned() const { return reinterpret_cast<uintptr_t>(this) % 64 == 0; }
+};
+
+int Aligned::alive = 0;
+
+void TestValueUserdata(LuaState& ls)
+{
+    ls.GlobalContext()
+        .BeginNamespace("test")
+        .BeginClass <Aligned>("Aligned")
+        .Def(Constructor<>())
+        .AddFunction("IsAligned", &Aligned::IsAligned)
+        .EndClass()
+        .EndNamespace();
+
+    ls.DoString("aligned = true for i = 1, 16 do aligned = aligned and test.Aligned():IsAligned() end");
+    ls.SetGlobal("copy", Aligned());
+    assert(ls.GetGlobal("aligned").Cast<bool>() && ls.GetGlobal("copy").Cast<Aligned*>()->IsAligned());
+    ls.DoString("copy = nil");
+    lua_gc(ls.GetState(), LUA_GCCOLLECT, 0);
+    assert(Aligned::alive == 0);
+}
+
+size_t RegistrationAllocations(MemberCount const& count)
+{
+    LuaState ls;
+    ls.EnableMemoryTracking();
+    std::vector<std::string> names;
+    for (int i = 0; i < 64; ++i)
+        names.push_back("Add" + std::to_string(i));
+
+    LuaMemoryStats const before = ls.MemoryStats();
+    auto c = ls.GlobalContext().BeginClass<Counter>("Counter", count);
+    for (size_t i = 0; i < names.size(); ++i)
+        c.AddFunction(names[i].c_str(), &Counter::Add);
+    c.EndClass();
+    LuaMemoryStats const after = ls.MemoryStats();
+
+    assert(!ls.GetGlobal("Counter").IsNil());
+    return (after.allocations + after.reallocations) - (before.allocations + before.reallocations);
+}
+
+void TestMemberCountHints()
+{
+    // Presized tables skip the rehashes while the members are added.
+    assert(RegistrationAllocations(MemberCount(64)) < RegistrationAllocations(MemberCount()));
+}
+
+void TestAllocators()
+{
+    {
+        LuaState pooled(std::unique_ptr<LuaAllocator>(new PoolAllocator()));
+        pooled.DoString("t = {} for i = 1, 1000 do t[i] = { i, tostring(i) } end n = #t");
+        assert(pooled.GetGlobal("n").Cast<int>() == 1000);
+    }
+    {
+        // Every refill fails when a chunk cannot be allocated, a shrink into
+        // the pool must still succeed.
+        PoolAllocator failing(static_cast<size_t>(-1) / 2);
+        void* const large = failing.Allocate(1024);
+        assert(large != NULL);
+        assert(failing.Allocate(64) == NULL);
+        assert(failing.Reallocate(large, 1024, 64) == large);
+        failing.Free(large, 64);
+    }
+    {
+        LuaState arena(std::unique_ptr<LuaAllocator>(new ArenaAllocator()));
+        arena.DoString("s = '' for i = 1, 100 do s = s .. i end n = #s");
+        assert(arena.GetGlobal("n").Cast<int>() == 192);
+    }
+    {
+        LuaState limited;
+        limited.EnableMemoryTracking();
+        limited.DoString("ok = true");
+        limited.SetMemoryLimit(limited.MemoryStats().liveBytes + 64 * 1024);
+        limited.DoString("ok = pcall(function() local t = {} for i = 1, 1e7 do t[i] = i end end)");
+        limited.SetMemoryLimit(0);
+        assert(!limited.GetGlobal("ok").Cast<bool>());
+
+        LuaMemoryStats const stats = limited.MemoryStats();
+        assert(stats.failedAllocations > 0);
+        assert(stats.peakBytes >= stats.liveBytes);
+        assert(stats.allocations > 0);
+    }
+}
+
 int main(int argc, char* argv[])
 {
     LuaState ls;
 
     TestNamespace(ls);
     TestStack(ls);
+    TestMemberDispatch(ls);
+    TestSmartPointers(ls);
+    TestValueUserdata(ls);
+    TestMemberCountHints();
+    TestAllocators();
+    TestRefCountedPtr();
+    TestStatePool();
+    TestSnapshot();
     
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "Bench.h"
+#include "BenchTypes.h"
+using namespace luaportal;
+
+//==============================================================================
+//
+// The system allocator compared with PoolAllocator and ArenaAllocator.
+//
+namespace
+{
+    /** Small tables, strings and closures, the common Lua block sizes. */
+    char const* const allocBody = "local t = { i, i + 1, x = i } local s = 'k' .. i local f = function() return t end";
+
+    /** A bounded job for the short-lived state benchmarks. */
+    char const* const job = "local t = {} for i = 1, 200 do t[i] = { i, tostring(i) } end";
+
+    LuaState* NewState(char const* allocator)
+    {
+        if(strcmp(allocator, "pool") == 0)
+            return new LuaState(std::unique_ptr<LuaAllocator>(new PoolAllocator()));
+        if(strcmp(allocator, "arena") == 0)
+            return new LuaState(std::unique_ptr<LuaAllocator>(new ArenaAllocator()));
+        return new LuaState();
+    }
+
+    void BenchScript(bench::State& state, char const* allocator)
+    {
+        std::unique_ptr<LuaState> ls(NewState(allocator));
+        RegisterBenchTypes(ls->GetState());
+        bench::RunScriptLoop(state, ls->GetState(), "", allocBody);
+    }
+
+    void BenchObjectCreation(bench::State& state, char const* allocator)
+    {
+        std::unique_ptr<LuaState> ls(NewState(allocator));
+        RegisterBenchTypes(ls->GetState());
+        bench::RunScriptLoop(state, ls->GetState(), "local Vec3 = bench.Vec3", "local v = Vec3(1, 2, 3)");
+    }
+
+    void BenchShortLivedState(bench::State& state, char const* allocator)
+    {
+        state.Start();
+        for(size_t i = 0; i < state.Iterations(); ++i)
+        {
+            std::unique_ptr<LuaState> ls(NewState(allocator));
+            ls->DoString(job);
+        }
+        state.Stop();
+    }
+}
+
+LPBENCH(Allocator_Script_Malloc)
+{
+    BenchScript(state, "malloc");
+}
+
+LPBENCH(Allocator_Script_Pool)
+{
+    BenchScript(state, "pool");
+}
+
+LPBENCH(Allocator_Script_MallocTracked)
+{
+    LuaState ls;
+    ls.EnableMemoryTracking();
+    bench::RunScriptLoop(state, ls.GetState(), "", allocBody);
+    state.SetCounter("peak_kb", ls.MemoryStats().peakBytes / 1024.0);
+}
+
+LPBENCH(Allocator_ObjectCreation_Malloc)
+{
+    BenchObjectCreation(state, "malloc");
+}
+
+LPBENCH(Allocator_ObjectCreation_Pool)
+{
+    BenchObjectCreation(state, "pool");
+}
+
+/** Peak memory with 1000 live objects, userdata size shows in peak_kb. */
+LPBENCH(Allocator_ObjectCreation_MallocTracked)
+{
+    LuaState ls;
+    ls.EnableMemoryTracking();
+    RegisterBenchTypes(ls.GetState());
+    bench::RunScriptLoop(state, ls.GetState(), "local Vec3 = bench.Vec3 local keep = {}", "keep[i % 1000 + 1] = Vec3(1, 2, 3)");
+    state.SetCounter("peak_kb", ls.MemoryStats().peakBytes / 1024.0);
+}
+
+LPBENCH(Allocator_ShortLivedState_Malloc)
+{
+    BenchShortLivedState(state, "malloc");
+}
+
+LPBENCH(Allocator_ShortLivedState_Pool)
+{
+    BenchShortLivedState(state, "pool");
+}
+
+LPBENCH(Allocator_ShortLivedState_Arena)
+{
+    BenchShortLivedState(state, "arena");
+}
@@ -0,0 +1,282 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+#include <lua.hpp>
+
+//==============================================================================
+/**
+ Minimal micro-benchmark harness used by lpbench.
+
+ A benchmark is a function taking a `bench::State&`. It performs its setup,
+ then brackets the measured loop with `Start()` / `Stop()` and runs the body
+ `Iterations()` times. The runner calibrates the iteration count so that each
+ benchmark runs for at least the requested minimum time, and reports ns/op,
+ C++ heap allocations/op and Lua allocator allocations/op.
+
+ e.g. @code
+ LPBENCH(Stack_int_Push)
+ {
+     bench::LuaBenchState ls;
+     lua_State* L = ls.Get();
+     state.Start();
+     for (size_t i = 0; i < state.Iterations(); ++i)
+     {
+         Stack<int>::Push(L, 42);
+         lua_pop(L, 1);
+     }
+     state.Stop();
+ }
+ @endcode
+ */
+namespace bench
+{
+    //--------------------------------------------------------------------------
+    /**
+     Number of C++ heap allocations made through operator new.
+
+     The counter is incremented by the replacement operator new in Main.cpp.
+     */
+    inline std::atomic<unsigned long long>& HeapAllocCount()
+    {
+        static std::atomic<unsigned long long> count(0);
+        return count;
+    }
+
+    //--------------------------------------------------------------------------
+    /**
+     Number of block allocations requested by Lua through CountingAlloc.
+
+     Reallocations that grow a block count as an allocation, shrinking and
+     freeing do not.
+     */
+    inline std::atomic<unsigned long long>& LuaAllocCount()
+    {
+        static std::atomic<unsigned long long> count(0);
+        return count;
+    }
+
+    //--------------------------------------------------------------------------
+    /**
+     A lua_Alloc that counts allocations and otherwise behaves like the
+     default allocator of luaL_newstate.
+     */
+    inline void* CountingAlloc(void* ud, void* ptr, size_t osize, size_t nsize)
+    {
+        (void)ud;
+        if(nsize == 0)
+        {
+            free(ptr);
+            return NULL;
+        }
+
+        if(ptr == NULL || nsize > osize)
+        {
+            LuaAllocCount().fetch_add(1, std::memory_order_relaxed);
+        }
+        return realloc(ptr, nsize);
+    }
+
+    inline int Panic(lua_State* L)
+    {
+        fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", lua_tostring(L, -1));
+        return 0;
+    }
+
+    //--------------------------------------------------------------------------
+    /**
+     A lua_State with the standard libraries open, whose allocations are
+     counted by the harness.
+     */
+    class LuaBenchState
+    {
+    private:
+        lua_State* L;
+
+        LuaBenchState(LuaBenchState const&);
+        LuaBenchState& operator=(LuaBenchState const&);
+
+    public:
+        LuaBenchState()
+        : L(lua_newstate(&CountingAlloc, NULL))
+        {
+            lua_atpanic(L, &Panic);
+            luaL_openlibs(L);
+        }
+
+        ~LuaBenchState()
+        {
+            lua_close(L);
+        }
+
+        lua_State* Get() const
+        {
+            return L;
+        }
+    };
+
+    //--------------------------------------------------------------------------
+    /**
+     Prevent the compiler from discarding a computed value.
+     */
+#if defined(__GNUC__) || defined(__clang__)
+    template<typename T>
+    inline void DoNotOptimize(T const& value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+#else
+    template<typename T>
+    inline void DoNotOptimize(T const& value)
+    {
+        static char const volatile* sink;
+        sink = reinterpret_cast<char const volatile*>(&value);
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+#endif
+
+    //--------------------------------------------------------------------------
+    /**
+     Per-run state handed to a benchmark function.
+     */
+    class State
+    {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        explicit State(size_t iterations)
+        : m_iterations(iterations)
+        , m_elapsed(0)
+        , m_heapAllocs(0)
+        , m_luaAllocs(0)
+        , m_running(false)
+        {
+        }
+
+        size_t Iterations() const
+        {
+            return m_iterations;
+        }
+
+        /** Begin the measured section. */
+        void Start()
+        {
+            m_heapStart = HeapAllocCount().load();
+            m_luaStart = LuaAllocCount().load();
+            m_running = true;
+            m_start = Clock::now();
+        }
+
+        /** End the measured section. */
+        void Stop()
+        {
+            Clock::time_point const end = Clock::now();
+            m_elapsed += std::chrono::duration<double, std::nano>(end - m_start).count();
+            m_heapAllocs += HeapAllocCount().load() - m_heapStart;
+            m_luaAllocs += LuaAllocCount().load() - m_luaStart;
+            m_running = false;
+        }
+
+        bool IsRunning() const { return m_running; }
+        double ElapsedNs() const { return m_elapsed; }
+        unsigned long long HeapAllocs() const { return m_heapAllocs; }
+        unsigned long long LuaAllocs() const { return m_luaAllocs; }
+
+        /** Attach a free-form counter to the report, e.g. bytes per object. */
+        void SetCounter(std::string const& name, double value)
+        {
+            m_counters.push_back(std::make_pair(name, value));
+        }
+
+        std::vector<std::pair<std::string, double> > const& Counters() const
+        {
+            return m_counters;
+        }
+
+    private:
+        size_t m_iterations;
+        double m_elapsed;
+        unsigned long long m_heapAllocs;
+        unsigned long long m_luaAllocs;
+        unsigned long long m_heapStart;
+        unsigned long long m_luaStart;
+        bool m_running;
+        Clock::time_point m_start;
+        std::vector<std::pair<std::string, double> > m_counters;
+    };
+
+    typedef std::function<void(State&)> Function;
+
+    struct Entry
+    {
+        std::string name;
+        Function function;
+    };
+
+    inline std::vector<Entry>& Registry()
+    {
+        static std::vector<Entry> entries;
+        return entries;
+    }
+
+    struct Registrar
+    {
+        Registrar(std::string const& name, Function const& function)
+        {
+            Entry entry;
+            entry.name = name;
+            entry.function = function;
+            Registry().push_back(entry);
+        }
+    };
+
+    //--------------------------------------------------------------------------
+    /**
+     Compile `prologue` followed by a loop running `body` n times, and leave
+     the loop function(taking n) on top of the stack.
+
+     Locals declared in the prologue are visible to the body as upvalues.
+     */
+    inline void PushScriptLoop(lua_State* L, char const* prologue, char const* body)
+    {
+        std::string source(prologue);
+        source += "\nreturn function(n) for i = 1, n do ";
+        source += body;
+        source += " end end";
+        if(luaL_loadstring(L, source.c_str()) != LUA_OK || lua_pcall(L, 0, 1, 0) != LUA_OK)
+        {
+            fprintf(stderr, "%s\n", lua_tostring(L, -1));
+            abort();
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    /**
+     Measure `body` executed by the Lua interpreter.
+     */
+    inline void RunScriptLoop(State& state, lua_State* L, char const* prologue, char const* body)
+    {
+        PushScriptLoop(L, prologue, body);
+        state.Start();
+        lua_pushinteger(L, static_cast<lua_Integer>(state.Iterations()));
+        lua_call(L, 1, 0);
+        state.Stop();
+    }
+}
+
+#define LPBENCH_CONCAT_IMPL(a, b) a##b
+#define LPBENCH_CONCAT(a, b) LPBENCH_CONCAT_IMPL(a, b)
+
+/** Define and register a benchmark function. */
+#define LPBENCH(NAME) \
+    static void NAME(bench::State& state); \
+    static bench::Registrar LPBENCH_CONCAT(NAME, _registrar)(#NAME, &NAME); \
+    static void NAME(bench::State& state)
+
+/** Register an existing callable under a runtime name. */
+#define LPBENCH_REGISTER(NAME, FUNCTION) \
+    static bench::Registrar LPBENCH_CONCAT(lpbench_registrar_, __LINE__)(NAME, FUNCTION)
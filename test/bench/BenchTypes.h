@@ -0,0 +1,193 @@
+#pragma once
+#include <array>
+#include <string>
+#include <luaportal/luaportal.h>
+#include <luaportal/refcountedobject.h>
+
+//==============================================================================
+/**
+ Classes shared by the lpbench benchmarks.
+ */
+struct Vec3
+{
+    Vec3() : x(0), y(0), z(0) {}
+    Vec3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+
+    float x;
+    float y;
+    float z;
+
+    float GetY() const { return y; }
+    void SetY(float v) { y = v; }
+
+    float Dot(Vec3 const& other) const
+    {
+        return x * other.x + y * other.y + z * other.z;
+    }
+
+    void Scale(float s)
+    {
+        x *= s;
+        y *= s;
+        z *= s;
+    }
+
+    static int Add(int a, int b)
+    {
+        return a + b;
+    }
+
+    static size_t Strings6(std::string a, std::string b, std::string c,
+                           std::string d, std::string e, std::string f)
+    {
+        return a.size() + b.size() + c.size() + d.size() + e.size() + f.size();
+    }
+};
+
+struct Vec4 : public Vec3
+{
+    float w = 0;
+};
+
+struct SealedVec4 : public Vec3
+{
+    float w = 0;
+};
+
+struct DirectVec3
+{
+    float x = 0;
+    float y = 0;
+
+    float GetY() const { return y; }
+    void SetY(float v) { y = v; }
+};
+
+template<bool isCached>
+struct Singleton
+{
+    float x = 0;
+
+    static Singleton* Instance()
+    {
+        static Singleton instance;
+        return &instance;
+    }
+};
+
+struct Shared : public RefCountedObject
+{
+    Shared() : value(0) {}
+    explicit Shared(int v) : value(v) {}
+
+    int value;
+};
+
+struct AtomicShared : public AtomicRefCountedObject
+{
+    AtomicShared() : value(0) {}
+    explicit AtomicShared(int v) : value(v) {}
+
+    int value;
+};
+
+//------------------------------------------------------------------------------
+/**
+ Register the benchmark types in the `bench` namespace of L.
+ */
+inline void RegisterBenchTypes(lua_State* L)
+{
+    using namespace luaportal;
+
+    // Larger than the small buffer of std::function implementations.
+    std::array<double, 4> const large = {{ 1, 2, 3, 4 }};
+
+    GetGlobalNamespace(L)
+        .BeginNamespace("bench")
+        .BeginClass<Vec3>("Vec3")
+        .Def(Constructor<float, float, float>())
+        .AddData("x", &Vec3::x)
+        .AddData("z", &Vec3::z)
+        .AddProperty("y", &Vec3::GetY, &Vec3::SetY)
+        .AddFunction("Dot", &Vec3::Dot)
+        .AddFunction("Scale", &Vec3::Scale)
+        .AddStaticFunction("Add", &Vec3::Add)
+        .AddStaticFunction("Strings6", &Vec3::Strings6)
+        .AddLambda("LambdaLength2", [](Vec3* v) { return v->Dot(*v); })
+        .AddStaticLambda("LambdaAdd", [](int a, int b) { return a + b; })
+        .AddStaticLambda("LambdaLargeCapture", [large](int a) { return a + large [0] + large [3]; })
+        .EndClass()
+        .DeriveClass<Vec4, Vec3>("Vec4")
+        .Def(Constructor<>())
+        .AddData("w", &Vec4::w)
+        .EndClass()
+        .DeriveClass<SealedVec4, Vec3>("SealedVec4")
+        .Def(Constructor<>())
+        .AddData("w", &SealedVec4::w)
+        .Seal()
+        .EndClass()
+        .BeginClass<DirectVec3>("DirectVec3")
+        .Def(Constructor<>())
+        .UseDirectAccessors()
+        .AddData("x", &DirectVec3::x)
+        .AddProperty("y", &DirectVec3::GetY, &DirectVec3::SetY)
+        .Seal()
+        .EndClass()
+        .BeginClass<Singleton<false>>("Singleton")
+        .AddData("x", &Singleton<false>::x)
+        .AddStaticFunction("Instance", &Singleton<false>::Instance)
+        .EndClass()
+        .BeginClass<Singleton<true>>("CachedSingleton")
+        .CachePointers()
+        .AddData("x", &Singleton<true>::x)
+        .AddStaticFunction("Instance", &Singleton<true>::Instance)
+        .EndClass()
+        .BeginClass<Shared>("Shared")
+        .Def<RefCountedObjectPtr<Shared>>(Constructor<int>())
+        .AddData("value", &Shared::value)
+        .EndClass()
+        .BeginClass<AtomicShared>("AtomicShared")
+        .Def<RefCountedObjectPtr<AtomicShared>>(Constructor<int>())
+        .AddData("value", &AtomicShared::value)
+        .EndClass()
+        .EndNamespace();
+}
+
+//------------------------------------------------------------------------------
+/**
+ Leave the closure registered as `name` in the class table of T on the stack.
+ */
+template<typename T>
+inline void PushClassMember(lua_State* L, char const* name)
+{
+    lua_rawgetp(L, LUA_REGISTRYINDEX, luaportal::ClassInfo<T>::GetClassKey());
+    lua_pushstring(L, name);
+    lua_rawget(L, -2);
+    lua_remove(L, -2);
+}
+
+//------------------------------------------------------------------------------
+/**
+ Leave the internal slot `key` of the class table of T on the stack.
+ */
+template<typename T>
+inline void PushClassMember(lua_State* L, luaportal::MetaKey key)
+{
+    lua_rawgetp(L, LUA_REGISTRYINDEX, luaportal::ClassInfo<T>::GetClassKey());
+    luaportal::rawgetkey(L, -1, key);
+    lua_remove(L, -2);
+}
+
+//------------------------------------------------------------------------------
+/**
+ Leave the closure registered as `name` in the static metatable of T on the
+ stack.
+ */
+template<typename T>
+inline void PushStaticMember(lua_State* L, char const* name)
+{
+    lua_rawgetp(L, LUA_REGISTRYINDEX, luaportal::ClassInfo<T>::GetStaticKey());
+    lua_pushstring(L, name);
+    lua_rawget(L, -2);
+    lua_remove(L, -2);
+}
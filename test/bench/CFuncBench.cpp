@@ -0,0 +1,386 @@
+#include "Bench.h"
+#include "BenchTypes.h"
+using namespace luaportal;
+
+//==============================================================================
+//
+// CFunc dispatch, measured by calling the generated closures through lua_call
+// so that only the binding layer and the Lua call frame are timed.
+//
+namespace
+{
+    /** Call the closure at `fn` with the given stack arguments pushed by push. */
+    template<typename PushArgs>
+    void BenchClosure(bench::State& state, lua_State* L, int fn, int nresults, PushArgs pushArgs)
+    {
+        int const top = lua_gettop(L);
+        state.Start();
+        for(size_t i = 0; i < state.Iterations(); ++i)
+        {
+            lua_pushvalue(L, fn);
+            int const nargs = pushArgs();
+            lua_call(L, nargs, nresults);
+            lua_settop(L, top);
+        }
+        state.Stop();
+    }
+}
+
+LPBENCH(CFunc_Call_StaticFunction)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    PushStaticMember<Vec3>(L, "Add");
+    int const fn = lua_gettop(L);
+
+    BenchClosure(state, L, fn, 1, [L]() {
+        lua_pushinteger(L, 1);
+        lua_pushinteger(L, 2);
+        return 2;
+    });
+}
+
+//------------------------------------------------------------------------------
+//
+// Six std::string arguments, comparing the index sequence expansion used by
+// FuncTraits with the recursive extraction it replaced, which passed every
+// extracted argument by value through each recursion level.
+//
+namespace
+{
+    template<typename R, typename D, typename... P>
+    struct LegacyRecursiveCall
+    {
+        template<typename... U>
+        static R Call(D fp, lua_State*, U... u)
+        {
+            return fp(u...);
+        }
+    };
+
+    template<typename R, typename D, typename H, typename... P>
+    struct LegacyRecursiveCall<R, D, H, P...>
+    {
+        template<typename... U>
+        static R Call(D fp, lua_State* L, U... u)
+        {
+            H h = Stack<H>::Get(L, static_cast<int>(1 + sizeof...(u)));
+            return LegacyRecursiveCall<R, D, P...>::Call(fp, L, u..., h);
+        }
+    };
+
+    int LegacyStrings6(lua_State* L)
+    {
+        typedef decltype(&Vec3::Strings6) FP;
+        typedef std::string S;
+        Stack<size_t>::Push(L, LegacyRecursiveCall<size_t, FP, S, S, S, S, S, S>::Call(&Vec3::Strings6, L));
+        return 1;
+    }
+
+    void BenchStrings6(bench::State& state, lua_State* L, int fn)
+    {
+        std::string const arg(64, 's');
+        BenchClosure(state, L, fn, 1, [L, &arg]() {
+            for(int i = 0; i < 6; ++i)
+            {
+                lua_pushlstring(L, arg.data(), arg.size());
+            }
+            return 6;
+        });
+    }
+}
+
+LPBENCH(CFunc_Call_Strings6)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    PushStaticMember<Vec3>(L, "Strings6");
+    BenchStrings6(state, L, lua_gettop(L));
+}
+
+LPBENCH(CFunc_Call_Strings6_LegacyRecursive)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    lua_pushcfunction(L, &LegacyStrings6);
+    BenchStrings6(state, L, lua_gettop(L));
+}
+
+LPBENCH(CFunc_CallMember)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    Vec3 v(1, 2, 3);
+    PushClassMember<Vec3>(L, "Scale");
+    int const fn = lua_gettop(L);
+
+    BenchClosure(state, L, fn, 0, [L, &v]() {
+        Stack<Vec3*>::Push(L, &v);
+        lua_pushnumber(L, 1.0);
+        return 2;
+    });
+}
+
+LPBENCH(CFunc_CallConstMember)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    Vec3 v(1, 2, 3);
+    PushClassMember<Vec3>(L, "Dot");
+    int const fn = lua_gettop(L);
+    Stack<Vec3*>::Push(L, &v);
+    int const self = lua_gettop(L);
+
+    BenchClosure(state, L, fn, 1, [L, self]() {
+        lua_pushvalue(L, self);
+        lua_pushvalue(L, self);
+        return 2;
+    });
+}
+
+LPBENCH(CFunc_GetProperty)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    Vec3 v(1, 2, 3);
+    PushClassMember<Vec3>(L, PropGetKey);
+    lua_getfield(L, -1, "x");
+    int const fn = lua_gettop(L);
+    Stack<Vec3*>::Push(L, &v);
+    int const self = lua_gettop(L);
+
+    BenchClosure(state, L, fn, 1, [L, self]() {
+        lua_pushvalue(L, self);
+        return 1;
+    });
+}
+
+LPBENCH(CFunc_SetProperty)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    Vec3 v(1, 2, 3);
+    PushClassMember<Vec3>(L, PropSetKey);
+    lua_getfield(L, -1, "x");
+    int const fn = lua_gettop(L);
+    Stack<Vec3*>::Push(L, &v);
+    int const self = lua_gettop(L);
+
+    BenchClosure(state, L, fn, 0, [L, self]() {
+        lua_pushvalue(L, self);
+        lua_pushnumber(L, 5.0);
+        return 2;
+    });
+}
+
+LPBENCH(MemberLambda_Call)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    Vec3 v(1, 2, 3);
+    PushClassMember<Vec3>(L, "LambdaLength2");
+    int const fn = lua_gettop(L);
+    Stack<Vec3*>::Push(L, &v);
+    int const self = lua_gettop(L);
+
+    BenchClosure(state, L, fn, 1, [L, self]() {
+        lua_pushvalue(L, self);
+        return 1;
+    });
+}
+
+LPBENCH(StaticLambda_Call)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    PushStaticMember<Vec3>(L, "LambdaAdd");
+    int const fn = lua_gettop(L);
+
+    BenchClosure(state, L, fn, 1, [L]() {
+        lua_pushinteger(L, 1);
+        lua_pushinteger(L, 2);
+        return 2;
+    });
+}
+
+LPBENCH(StaticLambda_CallLargeCapture)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    PushStaticMember<Vec3>(L, "LambdaLargeCapture");
+    int const fn = lua_gettop(L);
+
+    BenchClosure(state, L, fn, 1, [L]() {
+        lua_pushinteger(L, 1);
+        return 1;
+    });
+}
+
+//------------------------------------------------------------------------------
+//
+// Constructor proxies.
+//
+LPBENCH(ConstructorFunc_placementProxy)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    PushStaticMember<Vec3>(L, "__call");
+    int const fn = lua_gettop(L);
+    lua_rawgetp(L, LUA_REGISTRYINDEX, ClassInfo<Vec3>::GetStaticKey());
+    int const staticTable = lua_gettop(L);
+
+    BenchClosure(state, L, fn, 1, [L, staticTable]() {
+        lua_pushvalue(L, staticTable);
+        lua_pushnumber(L, 1.0);
+        lua_pushnumber(L, 2.0);
+        lua_pushnumber(L, 3.0);
+        return 4;
+    });
+}
+
+LPBENCH(ConstructorFunc_containerProxy)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    PushStaticMember<Shared>(L, "__call");
+    int const fn = lua_gettop(L);
+    lua_rawgetp(L, LUA_REGISTRYINDEX, ClassInfo<Shared>::GetStaticKey());
+    int const staticTable = lua_gettop(L);
+
+    BenchClosure(state, L, fn, 1, [L, staticTable]() {
+        lua_pushvalue(L, staticTable);
+        lua_pushinteger(L, 7);
+        return 2;
+    });
+}
+
+//------------------------------------------------------------------------------
+//
+// The same paths as seen from a script, including the __index/__newindex
+// metamethods.
+//
+static char const* const vecPrologue = "local v = bench.Vec3(1, 2, 3) local w = bench.Vec4() local s = bench.SealedVec4() local d = bench.DirectVec3() local Vec3 = bench.Vec3";
+
+LPBENCH(Script_MethodCall)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "v:Scale(1.0)");
+}
+
+LPBENCH(Script_ConstMethodCall)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "local d = v:Dot(v)");
+}
+
+LPBENCH(Script_InheritedMethodCall)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "w:Scale(1.0)");
+}
+
+LPBENCH(Script_DataRead)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "local x = v.x");
+}
+
+LPBENCH(Script_DataWrite)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "v.x = i");
+}
+
+LPBENCH(Script_InheritedDataRead)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "local x = w.x");
+}
+
+LPBENCH(Script_SealedInheritedMethodCall)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "s:Scale(1.0)");
+}
+
+LPBENCH(Script_SealedInheritedDataRead)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "local x = s.x");
+}
+
+LPBENCH(Script_PropertyRead)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "local y = v.y");
+}
+
+LPBENCH(Script_PropertyWrite)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "v.y = i");
+}
+
+/** DirectVec3 registers x and y as direct accessors of a sealed class. */
+LPBENCH(Script_DirectDataRead)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "local x = d.x");
+}
+
+LPBENCH(Script_DirectDataWrite)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "d.x = i");
+}
+
+LPBENCH(Script_DirectPropertyRead)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "local y = d.y");
+}
+
+LPBENCH(Script_DirectPropertyWrite)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "d.y = i");
+}
+
+LPBENCH(Script_StaticFunctionCall)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "local s = Vec3.Add(1, 2)");
+}
+
+LPBENCH(Script_Constructor)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), vecPrologue, "local o = Vec3(1, 2, 3)");
+}
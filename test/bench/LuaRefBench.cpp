@@ -0,0 +1,239 @@
+#include <vector>
+#include "Bench.h"
+#include "BenchTypes.h"
+using namespace luaportal;
+
+//==============================================================================
+//
+// LuaRef and the stack resident views.
+//
+static char const* const configScript =
+    "config = { window = { width = 800, title = 'lpbench' }, depth = { a = { b = { c = 1 } } } }";
+
+LPBENCH(LuaRef_Proxy_ChainedLookup)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    luaL_dostring(L, configScript);
+    LuaRef config = GetGlobal(L, "config");
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        bench::DoNotOptimize(config["window"]["width"].Cast<int>());
+    }
+    state.Stop();
+}
+
+LPBENCH(StackRef_ChainedLookup)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    luaL_dostring(L, configScript);
+    LuaRef config = GetGlobal(L, "config");
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        bench::DoNotOptimize(TableView(config)["window"]["width"].Cast<int>());
+    }
+    state.Stop();
+}
+
+LPBENCH(LuaRef_Proxy_DeepLookup)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    luaL_dostring(L, configScript);
+    LuaRef config = GetGlobal(L, "config");
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        bench::DoNotOptimize(config["depth"]["a"]["b"]["c"].Cast<int>());
+    }
+    state.Stop();
+}
+
+LPBENCH(StackRef_DeepLookup)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    luaL_dostring(L, configScript);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        bench::DoNotOptimize(StackRef::GetGlobal(L, "config")["depth"]["a"]["b"]["c"].Cast<int>());
+    }
+    state.Stop();
+}
+
+//------------------------------------------------------------------------------
+//
+// Returning, storing and reassigning references.
+//
+LPBENCH(LuaRef_ReturnFromGetGlobal)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    luaL_dostring(L, configScript);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        LuaRef config = GetGlobal(L, "config");
+        bench::DoNotOptimize(config);
+    }
+    state.Stop();
+}
+
+LPBENCH(LuaRef_StoreInVector)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    luaL_dostring(L, configScript);
+    size_t const batch = 1000;
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); i += batch)
+    {
+        // Growing the vector relocates the elements, which moves them now
+        // that the move constructor is noexcept.
+        std::vector<LuaRef> refs;
+        for(size_t j = 0; j < batch; ++j)
+        {
+            refs.push_back(GetGlobal(L, "config"));
+        }
+        bench::DoNotOptimize(refs);
+    }
+    state.Stop();
+}
+
+LPBENCH(LuaRef_AssignInPlace)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    LuaRef ref(L, 0);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        ref = static_cast<int>(i);
+    }
+    state.Stop();
+}
+
+LPBENCH(LuaRef_AssignUnrefRef)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    int ref = LUA_REFNIL;
+
+    // What LuaRef::operator= did before reusing the registry slot.
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        luaL_unref(L, LUA_REGISTRYINDEX, ref);
+        lua_pushinteger(L, static_cast<lua_Integer>(i));
+        ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    }
+    state.Stop();
+    luaL_unref(L, LUA_REGISTRYINDEX, ref);
+}
+
+//------------------------------------------------------------------------------
+//
+// Table traversal over 100k entries.
+//
+namespace
+{
+    int const tableSize = 100000;
+
+    void MakeTables(lua_State* L)
+    {
+        luaL_dostring(L,
+            "hash = {} for i = 1, 100000 do hash['k' .. i] = i end "
+            "array = {} for i = 1, 100000 do array[i] = i end");
+    }
+}
+
+LPBENCH(Iterator_Hash100k)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    MakeTables(L);
+    LuaRef hash = GetGlobal(L, "hash");
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); i += tableSize)
+    {
+        long sum = 0;
+        for(Iterator it(hash); !it.IsNil(); ++it)
+        {
+            sum += it.Value().Cast<int>();
+        }
+        bench::DoNotOptimize(sum);
+    }
+    state.Stop();
+}
+
+LPBENCH(Pairs_Hash100k)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    MakeTables(L);
+    LuaRef hash = GetGlobal(L, "hash");
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); i += tableSize)
+    {
+        long sum = 0;
+        for(auto const& entry : Pairs(hash))
+        {
+            sum += entry.Value<int>();
+        }
+        bench::DoNotOptimize(sum);
+    }
+    state.Stop();
+}
+
+LPBENCH(Pairs_Array100k)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    MakeTables(L);
+    LuaRef array = GetGlobal(L, "array");
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); i += tableSize)
+    {
+        long sum = 0;
+        for(auto const& entry : Pairs(array))
+        {
+            sum += entry.Value<int>();
+        }
+        bench::DoNotOptimize(sum);
+    }
+    state.Stop();
+}
+
+LPBENCH(IPairs_Array100k)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    MakeTables(L);
+    LuaRef array = GetGlobal(L, "array");
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); i += tableSize)
+    {
+        long sum = 0;
+        for(auto const& element : IPairs(array))
+        {
+            sum += element.Value<int>();
+        }
+        bench::DoNotOptimize(sum);
+    }
+    state.Stop();
+}
@@ -0,0 +1,122 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include "Bench.h"
+#include <luaportal/luaportal.h>
+using namespace luaportal;
+
+//==============================================================================
+//
+// LuaState::DoFile and DoString, with and without the chunk cache.
+//
+namespace
+{
+    char const* const snippet = "local t = {} for i = 1, 4 do t[i] = i * 2 end return t";
+
+    /** A script of a few hundred lines, so that parsing dominates. */
+    std::string const& ScriptPath()
+    {
+        static std::string const path = "lpbench_chunk.lua";
+        static bool const written = []() {
+            std::ofstream out(path.c_str());
+            for(int i = 0; i < 200; ++i)
+            {
+                out << "local function f" << i << "(a, b) return a * " << i << " + b end\n";
+            }
+            return true;
+        }();
+        (void)written;
+        return path;
+    }
+
+    void BenchDoString(bench::State& state, LuaState& ls)
+    {
+        state.Start();
+        for(size_t i = 0; i < state.Iterations(); ++i)
+        {
+            ls.DoString(snippet);
+        }
+        state.Stop();
+    }
+
+    void BenchDoFile(bench::State& state, LuaState& ls)
+    {
+        std::string const& path = ScriptPath();
+        state.Start();
+        for(size_t i = 0; i < state.Iterations(); ++i)
+        {
+            ls.DoFile(path);
+        }
+        state.Stop();
+    }
+
+    void SetCacheCounters(bench::State& state, ChunkCache const& cache)
+    {
+        ChunkCacheStats const& stats = cache.GetStats();
+        state.SetCounter("hits", static_cast<double>(stats.hits));
+        state.SetCounter("misses", static_cast<double>(stats.misses));
+        state.SetCounter("bytecode_hits", static_cast<double>(stats.bytecodeHits));
+    }
+}
+
+LPBENCH(LuaState_DoString)
+{
+    LuaState ls;
+    BenchDoString(state, ls);
+}
+
+LPBENCH(LuaState_DoString_ChunkCache)
+{
+    LuaState ls;
+    ls.EnableChunkCache();
+    BenchDoString(state, ls);
+    SetCacheCounters(state, *ls.GetChunkCache());
+}
+
+LPBENCH(LuaState_DoFile)
+{
+    LuaState ls;
+    BenchDoFile(state, ls);
+}
+
+LPBENCH(LuaState_DoFile_ChunkCache)
+{
+    LuaState ls;
+    ls.EnableChunkCache();
+    BenchDoFile(state, ls);
+    SetCacheCounters(state, *ls.GetChunkCache());
+}
+
+/** Cold start: a fresh state per iteration, loading from the bytecode cache. */
+LPBENCH(LuaState_DoFile_ColdBytecode)
+{
+    {
+        LuaState warm;
+        warm.EnableChunkCache(".");
+        warm.DoFile(ScriptPath());
+    }
+
+    ChunkCacheStats total;
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        LuaState ls;
+        ls.EnableChunkCache(".");
+        ls.DoFile(ScriptPath());
+        total.bytecodeHits += ls.GetChunkCache()->GetStats().bytecodeHits;
+    }
+    state.Stop();
+    state.SetCounter("bytecode_hits", static_cast<double>(total.bytecodeHits));
+}
+
+/** Cold start without the bytecode cache, for comparison. */
+LPBENCH(LuaState_DoFile_ColdSource)
+{
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        LuaState ls;
+        ls.DoFile(ScriptPath());
+    }
+    state.Stop();
+}
@@ -0,0 +1,84 @@
+#include <thread>
+#include <vector>
+#include "Bench.h"
+#include "BenchTypes.h"
+#include <luaportal/luastatepool.h>
+using namespace luaportal;
+
+//==============================================================================
+//
+// LuaStatePool throughput: every operation borrows a state, calls a script
+// handler and returns the state, spread over a number of worker threads.
+//
+namespace
+{
+    void Setup(LuaState& ls)
+    {
+        RegisterBenchTypes(ls.GetState());
+        ls.DoString("function handle(n) local v = bench.Vec3(n, n, n) return v:Dot(v) end");
+    }
+
+    void BenchPool(bench::State& state, size_t threads)
+    {
+        LuaStatePool::Options options;
+        options.initialStates = threads;
+        options.maxStates = threads;
+        LuaStatePool pool(&Setup, options);
+
+        size_t const perThread = (state.Iterations() + threads - 1) / threads;
+        std::vector<std::thread> workers;
+
+        state.Start();
+        for(size_t t = 0; t < threads; ++t)
+        {
+            workers.push_back(std::thread([&pool, perThread]() {
+                for(size_t i = 0; i < perThread; ++i)
+                {
+                    LuaStatePool::Lease lease = pool.Acquire();
+                    lua_State* L = lease.GetState();
+                    lua_getglobal(L, "handle");
+                    lua_pushinteger(L, static_cast<lua_Integer>(i));
+                    lua_call(L, 1, 1);
+                    bench::DoNotOptimize(lua_tonumber(L, -1));
+                }
+            }));
+        }
+        for(size_t t = 0; t < workers.size(); ++t)
+        {
+            workers [t].join();
+        }
+        state.Stop();
+        state.SetCounter("states", static_cast<double>(pool.Size()));
+    }
+}
+
+LPBENCH(LuaStatePool_Threads1)
+{
+    BenchPool(state, 1);
+}
+
+LPBENCH(LuaStatePool_Threads4)
+{
+    BenchPool(state, 4);
+}
+
+LPBENCH(LuaStatePool_Threads16)
+{
+    BenchPool(state, 16);
+}
+
+/** Borrowing and returning alone, without running any script. */
+LPBENCH(LuaStatePool_AcquireRelease)
+{
+    LuaStatePool::Options options;
+    options.initialStates = 1;
+    LuaStatePool pool(&Setup, options);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        LuaStatePool::Lease lease = pool.Acquire();
+        bench::DoNotOptimize(lease.GetState());
+    }
+    state.Stop();
+}
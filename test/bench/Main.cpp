@@ -0,0 +1,204 @@
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include "Bench.h"
+
+//==============================================================================
+//
+// Replacement global allocation functions, counting C++ heap allocations.
+//
+void* operator new(std::size_t size)
+{
+    bench::HeapAllocCount().fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if(p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) throw()
+{
+    free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+    free(p);
+}
+
+void operator delete(void* p, std::size_t) throw()
+{
+    free(p);
+}
+
+void operator delete[](void* p, std::size_t) throw()
+{
+    free(p);
+}
+
+namespace
+{
+    struct Result
+    {
+        std::string name;
+        size_t iterations;
+        double nsPerOp;
+        double heapAllocsPerOp;
+        double luaAllocsPerOp;
+        std::vector<std::pair<std::string, double> > counters;
+    };
+
+    bench::State RunOnce(bench::Entry const& entry, size_t iterations)
+    {
+        bench::State state(iterations);
+        entry.function(state);
+        assert(!state.IsRunning());
+        return state;
+    }
+
+    Result Run(bench::Entry const& entry, double minTimeNs)
+    {
+        // Grow the iteration count until a run takes a measurable amount of
+        // time, then size the final run to cover the minimum time.
+        size_t iterations = 1;
+        for(;;)
+        {
+            bench::State probe = RunOnce(entry, iterations);
+            if(probe.ElapsedNs() >= minTimeNs / 10 || iterations >= 1000000000)
+            {
+                double const perOp = probe.ElapsedNs() / iterations;
+                if(perOp > 0 && probe.ElapsedNs() < minTimeNs)
+                {
+                    iterations = static_cast<size_t>(minTimeNs / perOp) + 1;
+                }
+                break;
+            }
+            iterations *= 10;
+        }
+
+        bench::State state = RunOnce(entry, iterations);
+
+        Result result;
+        result.name = entry.name;
+        result.iterations = iterations;
+        result.nsPerOp = state.ElapsedNs() / iterations;
+        result.heapAllocsPerOp = static_cast<double>(state.HeapAllocs()) / iterations;
+        result.luaAllocsPerOp = static_cast<double>(state.LuaAllocs()) / iterations;
+        result.counters = state.Counters();
+        return result;
+    }
+
+    std::string EscapeJson(std::string const& s)
+    {
+        std::string out;
+        for(size_t i = 0; i < s.size(); ++i)
+        {
+            char const c = s[i];
+            if(c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out;
+    }
+
+    void WriteJson(std::ostream& os, std::vector<Result> const& results)
+    {
+        os << "{\n  \"benchmarks\": [\n";
+        for(size_t i = 0; i < results.size(); ++i)
+        {
+            Result const& r = results[i];
+            os << "    { \"name\": \"" << EscapeJson(r.name) << "\""
+               << ", \"iterations\": " << r.iterations
+               << ", \"ns_per_op\": " << r.nsPerOp
+               << ", \"allocs_per_op\": " << r.heapAllocsPerOp
+               << ", \"lua_allocs_per_op\": " << r.luaAllocsPerOp;
+            for(size_t c = 0; c < r.counters.size(); ++c)
+            {
+                os << ", \"" << EscapeJson(r.counters[c].first) << "\": " << r.counters[c].second;
+            }
+            os << " }" << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        os << "  ]\n}\n";
+    }
+
+    void Usage()
+    {
+        std::cout << "usage: lpbench [--filter=<substring>] [--min-time=<ms>] [--json=<path>] [--list]" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string filter;
+    std::string jsonPath = "lpbench.json";
+    double minTimeMs = 200;
+    bool listOnly = false;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        char const* arg = argv[i];
+        if(strncmp(arg, "--filter=", 9) == 0)
+            filter = arg + 9;
+        else if(strncmp(arg, "--min-time=", 11) == 0)
+            minTimeMs = atof(arg + 11);
+        else if(strncmp(arg, "--json=", 7) == 0)
+            jsonPath = arg + 7;
+        else if(strcmp(arg, "--list") == 0)
+            listOnly = true;
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    std::vector<Result> results;
+    std::vector<bench::Entry> const& entries = bench::Registry();
+
+    printf("%-48s %14s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op", "lua allocs/op");
+    for(size_t i = 0; i < entries.size(); ++i)
+    {
+        if(!filter.empty() && entries[i].name.find(filter) == std::string::npos)
+            continue;
+
+        if(listOnly)
+        {
+            printf("%s\n", entries[i].name.c_str());
+            continue;
+        }
+
+        Result const r = Run(entries[i], minTimeMs * 1e6);
+        printf("%-48s %14zu %12.2f %12.3f %12.3f", r.name.c_str(), r.iterations, r.nsPerOp, r.heapAllocsPerOp, r.luaAllocsPerOp);
+        for(size_t c = 0; c < r.counters.size(); ++c)
+        {
+            printf("  %s=%.2f", r.counters[c].first.c_str(), r.counters[c].second);
+        }
+        printf("\n");
+        fflush(stdout);
+        results.push_back(r);
+    }
+
+    if(!listOnly)
+    {
+        std::ofstream out(jsonPath.c_str());
+        if(!out)
+        {
+            std::cerr << "cannot write " << jsonPath << std::endl;
+            return 1;
+        }
+        WriteJson(out, results);
+    }
+
+    return 0;
+}
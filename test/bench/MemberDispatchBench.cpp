@@ -0,0 +1,145 @@
+#include <string>
+#include "Bench.h"
+#include "BenchTypes.h"
+using namespace luaportal;
+
+//==============================================================================
+//
+// Member lookup on classes with 5, 50 and 500 members: the table driven
+// ClassBase::IndexMetaMethod compared with the perfect hash dispatch of a
+// member list added with AddMembers().
+//
+namespace
+{
+    template<int N, bool isHashed>
+    struct Wide
+    {
+        float x = 0;
+
+        int Member() const
+        {
+            return N;
+        }
+    };
+
+    std::string MemberName(int i)
+    {
+        return "m" + std::to_string(i);
+    }
+
+    template<int N>
+    void RegisterWide(lua_State* L)
+    {
+        typedef Wide<N, false> Plain;
+        typedef Wide<N, true> Hashed;
+
+        static std::string names [N];
+        static MemberEntry members [N + 1];
+        for(int i = 0; i < N; ++i)
+        {
+            names [i] = MemberName(i);
+            members [i] = MemberFunctionThunk<int(Hashed::*)() const>::template Entry<&Hashed::Member>(names [i].c_str());
+        }
+        members [N] = LUAPORTAL_FIELD(Hashed, x);
+
+        auto c = GetGlobalNamespace(L)
+            .BeginNamespace("wide")
+            .BeginClass<Plain>("Plain", MemberCount(N, 1))
+            .Def(Constructor<>())
+            .AddData("x", &Plain::x);
+        for(int i = 0; i < N; ++i)
+        {
+            c.AddFunction(names [i].c_str(), &Plain::Member);
+        }
+        c.EndClass().EndNamespace();
+
+        GetGlobalNamespace(L)
+            .BeginNamespace("wide")
+            .BeginClass<Hashed>("Hashed", MemberCount(N, 1))
+            .Def(Constructor<>())
+            .AddMembers(members)
+            .EndClass()
+            .EndNamespace();
+    }
+
+    template<int N>
+    void BenchLookup(bench::State& state, char const* cls, std::string const& body)
+    {
+        bench::LuaBenchState ls;
+        RegisterWide<N>(ls.Get());
+        std::string const prologue = std::string("local o = wide.") + cls + "()";
+        bench::RunScriptLoop(state, ls.Get(), prologue.c_str(), body.c_str());
+    }
+
+    template<int N>
+    void BenchMethodCall(bench::State& state, char const* cls)
+    {
+        BenchLookup<N>(state, cls, "local r = o:" + MemberName(N / 2) + "()");
+    }
+
+    template<int N>
+    void BenchDataRead(bench::State& state, char const* cls)
+    {
+        BenchLookup<N>(state, cls, "local x = o.x");
+    }
+}
+
+LPBENCH(MemberDispatch_MethodCall5_Table)
+{
+    BenchMethodCall<5>(state, "Plain");
+}
+
+LPBENCH(MemberDispatch_MethodCall5_Hash)
+{
+    BenchMethodCall<5>(state, "Hashed");
+}
+
+LPBENCH(MemberDispatch_MethodCall50_Table)
+{
+    BenchMethodCall<50>(state, "Plain");
+}
+
+LPBENCH(MemberDispatch_MethodCall50_Hash)
+{
+    BenchMethodCall<50>(state, "Hashed");
+}
+
+LPBENCH(MemberDispatch_MethodCall500_Table)
+{
+    BenchMethodCall<500>(state, "Plain");
+}
+
+LPBENCH(MemberDispatch_MethodCall500_Hash)
+{
+    BenchMethodCall<500>(state, "Hashed");
+}
+
+LPBENCH(MemberDispatch_DataRead5_Table)
+{
+    BenchDataRead<5>(state, "Plain");
+}
+
+LPBENCH(MemberDispatch_DataRead5_Hash)
+{
+    BenchDataRead<5>(state, "Hashed");
+}
+
+LPBENCH(MemberDispatch_DataRead50_Table)
+{
+    BenchDataRead<50>(state, "Plain");
+}
+
+LPBENCH(MemberDispatch_DataRead50_Hash)
+{
+    BenchDataRead<50>(state, "Hashed");
+}
+
+LPBENCH(MemberDispatch_DataRead500_Table)
+{
+    BenchDataRead<500>(state, "Plain");
+}
+
+LPBENCH(MemberDispatch_DataRead500_Hash)
+{
+    BenchDataRead<500>(state, "Hashed");
+}
@@ -0,0 +1,56 @@
+#include "Bench.h"
+#include "BenchTypes.h"
+using namespace luaportal;
+
+//==============================================================================
+//
+// Pushing the same pointer over and over, as a getter returning a singleton
+// does: a new userdata per push compared with the per class pointer cache
+// enabled by CachePointers(). The full collection at the end is timed, the
+// garbage left by the uncached pushes is part of their cost.
+//
+namespace
+{
+    template<bool isCached>
+    void BenchRepeatedPush(bench::State& state)
+    {
+        bench::LuaBenchState ls;
+        lua_State* L = ls.Get();
+        RegisterBenchTypes(L);
+        Singleton<isCached>* const p = Singleton<isCached>::Instance();
+        int const top = lua_gettop(L);
+
+        state.Start();
+        for(size_t i = 0; i < state.Iterations(); ++i)
+        {
+            Stack<Singleton<isCached>*>::Push(L, p);
+            lua_settop(L, top);
+        }
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        state.Stop();
+    }
+}
+
+LPBENCH(PointerCache_RepeatedPush_Uncached)
+{
+    BenchRepeatedPush<false>(state);
+}
+
+LPBENCH(PointerCache_RepeatedPush_Cached)
+{
+    BenchRepeatedPush<true>(state);
+}
+
+LPBENCH(PointerCache_Script_SingletonGetter_Uncached)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), "local S = bench.Singleton", "local s = S.Instance()");
+}
+
+LPBENCH(PointerCache_Script_SingletonGetter_Cached)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), "local S = bench.CachedSingleton", "local s = S.Instance()");
+}
@@ -0,0 +1,72 @@
+#include "Bench.h"
+#include "BenchTypes.h"
+using namespace luaportal;
+
+//==============================================================================
+//
+// Handing shared objects to Lua and collecting them again, with the plain
+// RefCountedObject counter compared with AtomicRefCountedObject. Each
+// iteration pushes a new object; the final full collection is timed so the
+// releases from the __gc metamethods are part of the measurement.
+//
+namespace
+{
+    template<typename T>
+    void BenchPushCollect(bench::State& state)
+    {
+        bench::LuaBenchState ls;
+        lua_State* L = ls.Get();
+        RegisterBenchTypes(L);
+        int const top = lua_gettop(L);
+
+        state.Start();
+        for(size_t i = 0; i < state.Iterations(); ++i)
+        {
+            Stack<RefCountedObjectPtr<T>>::Push(L, RefCountedObjectPtr<T>(new T(static_cast<int>(i))));
+            lua_settop(L, top);
+        }
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        state.Stop();
+    }
+
+    /** A handle kept on the C++ side while Lua takes references to it. */
+    template<typename T>
+    void BenchPushExisting(bench::State& state)
+    {
+        bench::LuaBenchState ls;
+        lua_State* L = ls.Get();
+        RegisterBenchTypes(L);
+        RefCountedObjectPtr<T> p(new T(1));
+        int const top = lua_gettop(L);
+
+        state.Start();
+        for(size_t i = 0; i < state.Iterations(); ++i)
+        {
+            Stack<RefCountedObjectPtr<T>>::Push(L, p);
+            lua_settop(L, top);
+        }
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        state.Stop();
+        state.SetCounter("refs", static_cast<double>(p->getReferenceCount()));
+    }
+}
+
+LPBENCH(RefCountedObject_PushCollect_Plain)
+{
+    BenchPushCollect<Shared>(state);
+}
+
+LPBENCH(RefCountedObject_PushCollect_Atomic)
+{
+    BenchPushCollect<AtomicShared>(state);
+}
+
+LPBENCH(RefCountedObject_PushExisting_Plain)
+{
+    BenchPushExisting<Shared>(state);
+}
+
+LPBENCH(RefCountedObject_PushExisting_Atomic)
+{
+    BenchPushExisting<AtomicShared>(state);
+}
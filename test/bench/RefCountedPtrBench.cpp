@@ -0,0 +1,97 @@
+#include <thread>
+#include <vector>
+#include "Bench.h"
+#include "BenchTypes.h"
+#include <luaportal/refcountedptr.h>
+
+//==============================================================================
+//
+// RefCountedPtr copy and release under contention: worker threads copy
+// pointers out of a shared set of objects, for each reference count policy.
+// The global table policy is not thread-safe and only runs on one thread.
+//
+namespace
+{
+    struct Counted : public IntrusiveRefCount
+    {
+        int value = 0;
+    };
+
+    size_t const objectCount = 64;
+
+    template<typename Policy>
+    void BenchCopy(bench::State& state, size_t threads)
+    {
+        typedef RefCountedPtr<Counted, Policy> Ptr;
+        std::vector<Ptr> objects;
+        for(size_t i = 0; i < objectCount; ++i)
+        {
+            objects.push_back(Ptr(new Counted()));
+        }
+
+        size_t const perThread = (state.Iterations() + threads - 1) / threads;
+        std::vector<std::thread> workers;
+
+        state.Start();
+        for(size_t t = 0; t < threads; ++t)
+        {
+            workers.push_back(std::thread([&objects, perThread, t]() {
+                for(size_t i = 0; i < perThread; ++i)
+                {
+                    Ptr copy(objects [(i + t) % objectCount]);
+                    bench::DoNotOptimize(copy.Get());
+                }
+            }));
+        }
+        for(size_t t = 0; t < workers.size(); ++t)
+        {
+            workers [t].join();
+        }
+        state.Stop();
+    }
+}
+
+LPBENCH(RefCountedPtr_Copy_GlobalTable)
+{
+    BenchCopy<GlobalTableRefCount>(state, 1);
+}
+
+LPBENCH(RefCountedPtr_Copy_Sharded_Threads1)
+{
+    BenchCopy<ShardedRefCount>(state, 1);
+}
+
+LPBENCH(RefCountedPtr_Copy_Sharded_Threads4)
+{
+    BenchCopy<ShardedRefCount>(state, 4);
+}
+
+LPBENCH(RefCountedPtr_Copy_Sharded_Threads16)
+{
+    BenchCopy<ShardedRefCount>(state, 16);
+}
+
+LPBENCH(RefCountedPtr_Copy_Sharded_Threads32)
+{
+    BenchCopy<ShardedRefCount>(state, 32);
+}
+
+LPBENCH(RefCountedPtr_Copy_Intrusive_Threads1)
+{
+    BenchCopy<AtomicIntrusiveRefCount>(state, 1);
+}
+
+LPBENCH(RefCountedPtr_Copy_Intrusive_Threads4)
+{
+    BenchCopy<AtomicIntrusiveRefCount>(state, 4);
+}
+
+LPBENCH(RefCountedPtr_Copy_Intrusive_Threads16)
+{
+    BenchCopy<AtomicIntrusiveRefCount>(state, 16);
+}
+
+LPBENCH(RefCountedPtr_Copy_Intrusive_Threads32)
+{
+    BenchCopy<AtomicIntrusiveRefCount>(state, 32);
+}
@@ -0,0 +1,57 @@
+#include <string>
+#include <vector>
+#include "Bench.h"
+#include "BenchTypes.h"
+using namespace luaportal;
+
+//==============================================================================
+//
+// Registration of a class with 200 methods, with and without member counts
+// declared up front. Each iteration registers into a fresh state.
+//
+namespace
+{
+    int const methodCount = 200;
+
+    std::vector<std::string> const& MethodNames()
+    {
+        static std::vector<std::string> names;
+        if(names.empty())
+        {
+            for(int i = 0; i < methodCount; ++i)
+            {
+                names.push_back("Method" + std::to_string(i));
+            }
+        }
+        return names;
+    }
+
+    void BenchRegistration(bench::State& state, MemberCount const& count)
+    {
+        std::vector<std::string> const& names = MethodNames();
+        state.Start();
+        for(size_t i = 0; i < state.Iterations(); ++i)
+        {
+            bench::LuaBenchState ls;
+            auto c = GetGlobalNamespace(ls.Get())
+                .BeginNamespace("bench")
+                .BeginClass<Vec3>("Vec3", count);
+            for(int m = 0; m < methodCount; ++m)
+            {
+                c.AddFunction(names [m].c_str(), &Vec3::Scale);
+            }
+            c.EndClass().EndNamespace();
+        }
+        state.Stop();
+    }
+}
+
+LPBENCH(Registration_Class200Methods)
+{
+    BenchRegistration(state, MemberCount());
+}
+
+LPBENCH(Registration_Class200Methods_Presized)
+{
+    BenchRegistration(state, MemberCount(methodCount));
+}
@@ -0,0 +1,49 @@
+#include "Bench.h"
+#include "BenchTypes.h"
+using namespace luaportal;
+
+//==============================================================================
+//
+// Bringing up a fully registered state: running the registration chain
+// compared with replaying a RegistrationSnapshot of it.
+//
+namespace
+{
+    RegistrationSnapshot const& BenchTypesSnapshot()
+    {
+        static RegistrationSnapshot const snapshot = RegistrationSnapshot::Capture(&RegisterBenchTypes);
+        return snapshot;
+    }
+}
+
+LPBENCH(Snapshot_NewState_Register)
+{
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        bench::LuaBenchState ls;
+        RegisterBenchTypes(ls.Get());
+    }
+    state.Stop();
+}
+
+LPBENCH(Snapshot_NewState_Apply)
+{
+    RegistrationSnapshot const& snapshot = BenchTypesSnapshot();
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        bench::LuaBenchState ls;
+        snapshot.Apply(ls.Get());
+    }
+    state.Stop();
+    state.SetCounter("objects", static_cast<double>(snapshot.GetObjectCount()));
+}
+
+/** The replayed state must behave like a registered one. */
+LPBENCH(Snapshot_Script_MethodCall)
+{
+    bench::LuaBenchState ls;
+    BenchTypesSnapshot().Apply(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), "local v = bench.Vec3(1, 2, 3)", "v:Scale(1.0)");
+}
@@ -0,0 +1,337 @@
+#include <string>
+#include "Bench.h"
+#include "BenchTypes.h"
+using namespace luaportal;
+
+//==============================================================================
+//
+// Stack<T> conversions.
+//
+namespace
+{
+    template<typename T>
+    void BenchPush(bench::State& state, T value)
+    {
+        bench::LuaBenchState ls;
+        lua_State* L = ls.Get();
+        int const top = lua_gettop(L);
+
+        state.Start();
+        for(size_t i = 0; i < state.Iterations(); ++i)
+        {
+            Stack<T>::Push(L, value);
+            lua_settop(L, top);
+        }
+        state.Stop();
+    }
+
+    template<typename T, typename V>
+    void BenchGet(bench::State& state, V value)
+    {
+        bench::LuaBenchState ls;
+        lua_State* L = ls.Get();
+        Stack<V>::Push(L, value);
+
+        state.Start();
+        for(size_t i = 0; i < state.Iterations(); ++i)
+        {
+            bench::DoNotOptimize(Stack<T>::Get(L, -1));
+        }
+        state.Stop();
+    }
+
+    template<typename T>
+    void BenchCheckType(bench::State& state, T value)
+    {
+        bench::LuaBenchState ls;
+        lua_State* L = ls.Get();
+        Stack<T>::Push(L, value);
+
+        state.Start();
+        for(size_t i = 0; i < state.Iterations(); ++i)
+        {
+            bench::DoNotOptimize(Stack<T>::CheckType(L, -1));
+        }
+        state.Stop();
+    }
+
+    template<typename T>
+    struct StackBenchRegistrar
+    {
+        StackBenchRegistrar(char const* name, T value)
+        {
+            std::string const prefix = std::string("Stack<") + name + ">::";
+            bench::Registrar(prefix + "Push", [value](bench::State& state) { BenchPush<T>(state, value); });
+            bench::Registrar(prefix + "Get", [value](bench::State& state) { BenchGet<T, T>(state, value); });
+            bench::Registrar(prefix + "CheckType", [value](bench::State& state) { BenchCheckType<T>(state, value); });
+        }
+    };
+
+    std::string const shortString = "short";
+    std::string const longString(256, 'x');
+}
+
+#define LPBENCH_STACK(TYPE, VALUE) \
+    static StackBenchRegistrar<TYPE> LPBENCH_CONCAT(stack_registrar_, __LINE__)(#TYPE, VALUE)
+
+LPBENCH_STACK(int, 42);
+LPBENCH_STACK(int const&, 42);
+LPBENCH_STACK(unsigned int, 42u);
+LPBENCH_STACK(unsigned int const&, 42u);
+LPBENCH_STACK(unsigned char, static_cast<unsigned char>(42));
+LPBENCH_STACK(unsigned char const&, static_cast<unsigned char>(42));
+LPBENCH_STACK(short, static_cast<short>(42));
+LPBENCH_STACK(short const&, static_cast<short>(42));
+LPBENCH_STACK(unsigned short, static_cast<unsigned short>(42));
+LPBENCH_STACK(unsigned short const&, static_cast<unsigned short>(42));
+LPBENCH_STACK(long, 42l);
+LPBENCH_STACK(long const&, 42l);
+LPBENCH_STACK(unsigned long, 42ul);
+LPBENCH_STACK(unsigned long const&, 42ul);
+LPBENCH_STACK(float, 4.2f);
+LPBENCH_STACK(float const&, 4.2f);
+LPBENCH_STACK(double, 4.2);
+LPBENCH_STACK(double const&, 4.2);
+LPBENCH_STACK(bool, true);
+LPBENCH_STACK(bool const&, true);
+LPBENCH_STACK(char, 'c');
+LPBENCH_STACK(char const&, 'c');
+LPBENCH_STACK(char const*, "a string literal");
+LPBENCH_STACK(std::string, shortString);
+LPBENCH_STACK(std::string const&, shortString);
+
+LPBENCH(Stack_std_string_long_Push)
+{
+    BenchPush<std::string>(state, longString);
+}
+
+LPBENCH(Stack_std_string_long_Get)
+{
+    BenchGet<std::string, std::string>(state, longString);
+}
+
+LPBENCH(Stack_std_string_const_ref_long_Get)
+{
+    BenchGet<std::string const&, std::string>(state, longString);
+}
+
+LPBENCH(Stack_StringRef_long_Get)
+{
+    BenchGet<StringRef, std::string>(state, longString);
+}
+
+LPBENCH(Stack_ByteSpan_long_Get)
+{
+    BenchGet<ByteSpan, std::string>(state, longString);
+}
+
+#ifdef LUAPORTAL_HAS_STRING_VIEW
+LPBENCH(Stack_std_string_view_long_Get)
+{
+    BenchGet<std::string_view, std::string>(state, longString);
+}
+#endif
+
+//------------------------------------------------------------------------------
+//
+// lua_CFunction and std::function.
+//
+static int NoopCFunction(lua_State*)
+{
+    return 0;
+}
+
+LPBENCH(Stack_lua_CFunction_Push)
+{
+    BenchPush<lua_CFunction>(state, &NoopCFunction);
+}
+
+LPBENCH(Stack_lua_CFunction_Get)
+{
+    BenchGet<lua_CFunction, lua_CFunction>(state, &NoopCFunction);
+}
+
+LPBENCH(Stack_std_function_Push)
+{
+    std::function<int(int)> f = [](int v) { return v + 1; };
+    BenchPush<std::function<int(int)>>(state, f);
+}
+
+LPBENCH(Stack_std_function_GetFromUserdata)
+{
+    std::function<int(int)> f = [](int v) { return v + 1; };
+    BenchGet<std::function<int(int)>, std::function<int(int)>>(state, f);
+}
+
+LPBENCH(Stack_std_function_GetFromLuaFunction)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    luaL_dostring(L, "callback = function(v) return v + 1 end");
+    lua_getglobal(L, "callback");
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        std::function<int(int)> f = Stack<std::function<int(int)>>::Get(L, -1);
+        bench::DoNotOptimize(f);
+    }
+    state.Stop();
+}
+
+LPBENCH(Stack_std_function_CallLuaFunction)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    luaL_dostring(L, "callback = function(v) return v + 1 end");
+    lua_getglobal(L, "callback");
+    std::function<int(int)> f = Stack<std::function<int(int)>>::Get(L, -1);
+    lua_pop(L, 1);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        bench::DoNotOptimize(f(static_cast<int>(i)));
+    }
+    state.Stop();
+}
+
+LPBENCH(Stack_std_function_CallLuaFunction_Void)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    luaL_dostring(L, "callback = function(v) end");
+    lua_getglobal(L, "callback");
+    std::function<void(int)> f = Stack<std::function<void(int)>>::Get(L, -1);
+    lua_pop(L, 1);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        f(static_cast<int>(i));
+    }
+    state.Stop();
+}
+
+//------------------------------------------------------------------------------
+//
+// Class objects.
+//
+LPBENCH(Stack_ClassPointer_Push)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    Vec3 v;
+    int const top = lua_gettop(L);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        Stack<Vec3*>::Push(L, &v);
+        lua_settop(L, top);
+    }
+    state.Stop();
+}
+
+LPBENCH(Stack_ClassPointer_Get)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    Vec3 v;
+    Stack<Vec3*>::Push(L, &v);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        bench::DoNotOptimize(Stack<Vec3*>::Get(L, -1));
+    }
+    state.Stop();
+}
+
+LPBENCH(Stack_DerivedClassPointer_GetAsBase)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    Vec4 v;
+    Stack<Vec4*>::Push(L, &v);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        bench::DoNotOptimize(Stack<Vec3*>::Get(L, -1));
+    }
+    state.Stop();
+}
+
+LPBENCH(Stack_ClassValue_Push)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    Vec3 v(1, 2, 3);
+    int const top = lua_gettop(L);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        Stack<Vec3>::Push(L, v);
+        lua_settop(L, top);
+    }
+    state.Stop();
+}
+
+LPBENCH(Stack_RefCountedObjectPtr_Push)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    RefCountedObjectPtr<Shared> p(new Shared(1));
+    int const top = lua_gettop(L);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        Stack<RefCountedObjectPtr<Shared>>::Push(L, p);
+        lua_settop(L, top);
+    }
+    state.Stop();
+    lua_gc(L, LUA_GCCOLLECT, 0);
+}
+
+LPBENCH(Stack_SharedPtr_Push)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    std::shared_ptr<Vec3> p = std::make_shared<Vec3>(1.0f, 2.0f, 3.0f);
+    int const top = lua_gettop(L);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        Stack<std::shared_ptr<Vec3>>::Push(L, p);
+        lua_settop(L, top);
+    }
+    state.Stop();
+    lua_gc(L, LUA_GCCOLLECT, 0);
+}
+
+LPBENCH(Stack_UniquePtr_Push)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    int const top = lua_gettop(L);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        Stack<std::unique_ptr<Vec3>>::Push(L, std::unique_ptr<Vec3>(new Vec3(1.0f, 2.0f, 3.0f)));
+        lua_settop(L, top);
+    }
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    state.Stop();
+}
@@ -0,0 +1,61 @@
+#include "Bench.h"
+#include "BenchTypes.h"
+using namespace luaportal;
+
+//==============================================================================
+//
+// Small objects pushed by value: creation and collection time, and the Lua
+// heap taken by each object, which includes the userdata header.
+//
+namespace
+{
+    size_t HeapBytes(lua_State* L)
+    {
+        return static_cast<size_t>(lua_gc(L, LUA_GCCOUNT, 0)) * 1024
+            + static_cast<size_t>(lua_gc(L, LUA_GCCOUNTB, 0));
+    }
+
+    /** Heap bytes per object, for objects kept alive in a table. */
+    double BytesPerObject(lua_State* L)
+    {
+        int const count = 1000;
+        lua_createtable(L, count, 0);
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        size_t const before = HeapBytes(L);
+        for(int i = 1; i <= count; ++i)
+        {
+            Stack<Vec3>::Push(L, Vec3(1.0f, 2.0f, 3.0f));
+            lua_rawseti(L, -2, i);
+        }
+        size_t const after = HeapBytes(L);
+        lua_pop(L, 1);
+        lua_gc(L, LUA_GCCOLLECT, 0);
+        return static_cast<double>(after - before) / count;
+    }
+}
+
+LPBENCH(UserdataValue_PushCollect_Vec3)
+{
+    bench::LuaBenchState ls;
+    lua_State* L = ls.Get();
+    RegisterBenchTypes(L);
+    Vec3 const v(1.0f, 2.0f, 3.0f);
+    int const top = lua_gettop(L);
+
+    state.Start();
+    for(size_t i = 0; i < state.Iterations(); ++i)
+    {
+        Stack<Vec3>::Push(L, v);
+        lua_settop(L, top);
+    }
+    lua_gc(L, LUA_GCCOLLECT, 0);
+    state.Stop();
+    state.SetCounter("bytes", BytesPerObject(L));
+}
+
+LPBENCH(UserdataValue_Script_Construct_Vec3)
+{
+    bench::LuaBenchState ls;
+    RegisterBenchTypes(ls.Get());
+    bench::RunScriptLoop(state, ls.Get(), "local Vec3 = bench.Vec3", "local v = Vec3(1, 2, 3)");
+}